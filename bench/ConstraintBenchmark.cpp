@@ -0,0 +1,135 @@
+// Times one distance constraint solver pass over the store PatternMesh used before PatternConstraints,
+// a std::map of std::set per vertex, and over the edge list of PatternConstraints
+// The map/set store holds both directions of every constraint, the edge list holds each one once
+// usage: ConstraintBenchmark [rounds] [repetitions]
+
+#include "PatternConstraints.h"
+#include "PatternGraph.h"
+#include "PatternGenerator.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace ami;
+
+namespace
+{
+	// the constraints of every vertex as PatternMesh kept them before: target and distance, sorted
+	typedef std::map<IndexType, std::set<std::pair<IndexType, float>>> MapConstraints;
+
+	struct Positions
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+	};
+
+	// moves a and b half way each towards distance, as PatternMesh::solveConstraints() does
+	inline void project(Positions & p, IndexType a, IndexType b, float distance)
+	{
+		float dx = p.x[a] - p.x[b];
+		float dy = p.y[a] - p.y[b];
+		float dz = p.z[a] - p.z[b];
+		float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+		if (dist == 0.0f) dist = std::numeric_limits<float>::epsilon(); // check for zero division
+
+		float tx = dx * (distance - dist) / dist;
+		float ty = dy * (distance - dist) / dist;
+		float tz = dz * (distance - dist) / dist;
+		p.x[a] += tx * 0.5f;
+		p.y[a] += ty * 0.5f;
+		p.z[a] += tz * 0.5f;
+		p.x[b] -= tx * 0.5f;
+		p.y[b] -= ty * 0.5f;
+		p.z[b] -= tz * 0.5f;
+	}
+
+	void solve(const MapConstraints & constraints, Positions & positions)
+	{
+		for (auto & con : constraints)
+		{
+			for (auto & target : con.second)
+			{
+				project(positions, con.first, target.first, target.second);
+			}
+		}
+	}
+
+	void solve(const PatternConstraints & constraints, Positions & positions)
+	{
+		for (IndexType c = 0; c < constraints.size(); c++)
+		{
+			project(positions, constraints.getA(c), constraints.getB(c), constraints.getDistance(c));
+		}
+	}
+
+	// mean time of one solver pass, in ns
+	template <typename Constraints>
+	double timePass(const Constraints & constraints, Positions & positions, unsigned int repetitions)
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		solve(constraints, positions); // warm up
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < repetitions; i++)
+		{
+			solve(constraints, positions);
+		}
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / repetitions;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	unsigned int rounds = argc > 1 ? std::atoi(argv[1]) : 100;
+	unsigned int repetitions = argc > 2 ? std::atoi(argv[2]) : 100;
+
+	PatternGenerator::Settings sphere;
+	sphere.rounds = rounds;
+
+	// 32 bit ids whatever the size, as the stores below take them
+	PatternGraph::WideGraph graph(PatternGenerator::generate(sphere));
+	IndexType vertices = graph.getNodes().size();
+
+	// the spiral PatternMesh starts from
+	Positions start;
+	for (IndexType v = 0; v < vertices; v++)
+	{
+		float angle = v / 10.f * TwoPi;
+		start.x.push_back(-2.0f * std::sin(angle));
+		start.y.push_back(v / 10.f);
+		start.z.push_back(-2.0f * std::cos(angle));
+	}
+
+	// both directions of every edge in the map/set store, as PatternMesh::setDistanceConstrain added them
+	MapConstraints mapConstraints;
+	PatternConstraints edgeConstraints;
+	for (auto & edge : graph.getEdges())
+	{
+		mapConstraints[edge.from].insert({ edge.to, edge.distance });
+		mapConstraints[edge.to].insert({ edge.from, edge.distance });
+		edgeConstraints.add(edge.from, edge.to, edge.distance);
+	}
+	edgeConstraints.build(vertices);
+
+	std::size_t mapCount = 0;
+	for (auto & con : mapConstraints) mapCount += con.second.size();
+
+	Positions mapPositions = start;
+	Positions edgePositions = start;
+	double mapNs = timePass(mapConstraints, mapPositions, repetitions);
+	double edgeNs = timePass(edgeConstraints, edgePositions, repetitions);
+
+	std::cout << "vertices: " << vertices << std::endl;
+	std::cout << "map/set pass: " << mapNs / 1e6 << " ms (" << mapCount << " constraints)" << std::endl;
+	std::cout << "edges pass:   " << edgeNs / 1e6 << " ms (" << edgeConstraints.size() << " constraints), "
+		<< mapNs / edgeNs << "x" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+// Times PatternMesh::updateNormals() on its own, apart from the constraint solver
+// usage: NormalsBenchmark [rounds] [repetitions] [threads]
+
+#include "PatternGraph.h"
+#include "PatternMesh.h"
+#include "PatternGenerator.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace ami;
+
+int main(int argc, char * argv[])
+{
+	unsigned int rounds = argc > 1 ? std::atoi(argv[1]) : 100;
+	unsigned int repetitions = argc > 2 ? std::atoi(argv[2]) : 100;
+	unsigned int threads = argc > 3 ? std::atoi(argv[3]) : 1;
+
+	PatternGenerator::Settings sphere;
+	sphere.rounds = rounds;
+
+	PatternGraph graph(PatternGenerator::generate(sphere));
+	PatternMesh mesh(graph);
+	mesh.setThreadCount(threads);
+
+	size_t vertices = graph.getNodeCount();
+
+	typedef std::chrono::steady_clock Clock;
+
+	mesh.updateNormals(); // warm up
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < repetitions; i++)
+	{
+		mesh.updateNormals();
+	}
+	double normalsNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / repetitions;
+
+	start = Clock::now();
+	for (unsigned int i = 0; i < repetitions; i++)
+	{
+		mesh.update(0.016f);
+	}
+	double stepNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / repetitions;
+
+	std::cout << "vertices: " << vertices << ", faces: " << graph.getFaceCount() << ", threads: " << threads << std::endl;
+	std::cout << "updateNormals: " << normalsNs / 1e6 << " ms (" << normalsNs / vertices << " ns/vertex)" << std::endl;
+	std::cout << "update step:   " << stepNs / 1e6 << " ms (normals " << 100.0 * normalsNs / stepNs << "%)" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,321 @@
+// Times each stage of the core on the shipped patterns and on generated spheres:
+// PatternDigest::digest of the xml and of its .amib conversion, PatternGraph construction, serial and on --threads,
+// PatternMesh construction and one PatternMesh::update step
+// Reports ns/stitch, bytes/stitch (live heap after construction, and its peak during construction) and optionally writes the results as JSON
+// usage: PatternBenchmark [--data bin/data] [-s 1000 -s 10000 ...] [--json results.json]
+
+#include "PatternBinary.h"
+#include "PatternDigest.h"
+#include "PatternGraph.h"
+#include "PatternMesh.h"
+#include "PatternGenerator.h"
+#include "cxxopts.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+using namespace ami;
+
+// live heap bytes, every allocation goes through the operator new replacements below
+static std::atomic<long long> g_liveBytes(0);
+// highest g_liveBytes since it was last reset to it, reallocations show up here as old and new buffers are both alive
+static std::atomic<long long> g_peakBytes(0);
+
+// size is kept in front of the block, padded to keep the alignment of operator new
+static const std::size_t headerSize = alignof(std::max_align_t);
+
+void * operator new(std::size_t size)
+{
+	void * raw = std::malloc(size + headerSize);
+	if (!raw) throw std::bad_alloc();
+	*static_cast<std::size_t *>(raw) = size;
+	long long live = g_liveBytes += size;
+	long long peak = g_peakBytes;
+	while (live > peak && !g_peakBytes.compare_exchange_weak(peak, live)) {}
+	return static_cast<char *>(raw) + headerSize;
+}
+
+void operator delete(void * pointer) noexcept
+{
+	if (!pointer) return;
+	void * raw = static_cast<char *>(pointer) - headerSize;
+	g_liveBytes -= *static_cast<std::size_t *>(raw);
+	std::free(raw);
+}
+
+void * operator new[](std::size_t size) { return operator new(size); }
+void operator delete[](void * pointer) noexcept { operator delete(pointer); }
+void operator delete(void * pointer, std::size_t) noexcept { operator delete(pointer); }
+void operator delete[](void * pointer, std::size_t) noexcept { operator delete(pointer); }
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Stage
+	{
+		double ns = 0.0; // mean time of one run
+		unsigned int runs = 0;
+		long long bytes = -1; // heap kept by the result, -1 when not measured
+		long long peak = -1; // highest heap while building the result, over what there was before
+	};
+
+	struct Result
+	{
+		std::string name;
+		std::string source; // "file" or "generated"
+		std::size_t stitches = 0;
+		std::size_t vertices = 0;
+		std::size_t constraints = 0;
+		std::size_t faces = 0;
+		Stage digest;
+		Stage binary;
+		Stage graph;
+		Stage parallelGraph;
+		Stage mesh;
+		Stage update;
+	};
+
+	// runs function until minSeconds have passed, at least once
+	template <class Function>
+	Stage measure(double minSeconds, Function function)
+	{
+		Stage stage;
+		Clock::time_point start = Clock::now();
+		double elapsed = 0.0;
+		do
+		{
+			function();
+			stage.runs++;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < minSeconds);
+
+		stage.ns = elapsed * 1e9 / stage.runs;
+		return stage;
+	}
+
+	Result run(const std::string & name, const std::string & source, const std::string & file, unsigned int threads, double minSeconds)
+	{
+		Result result;
+		result.name = name;
+		result.source = source;
+
+		result.digest = measure(minSeconds, [&]() { PatternDigest::digest(file); });
+
+		long long before = g_liveBytes;
+		std::vector<PatternDef> patterns = PatternDigest::digest(file);
+		result.digest.bytes = g_liveBytes - before;
+		if (patterns.empty())
+		{
+			throw std::invalid_argument("No pattern in " + file);
+		}
+		result.stitches = patterns[0].getStitchCount();
+
+		std::string binaryFile = (std::filesystem::temp_directory_path() / (name + PatternBinary::getExtension())).string();
+		if (!PatternBinary::save(patterns, binaryFile))
+		{
+			throw std::invalid_argument("Could not write " + binaryFile);
+		}
+		result.binary = measure(minSeconds, [&]() { PatternDigest::digest(binaryFile); });
+		std::remove(binaryFile.c_str());
+
+		result.graph = measure(minSeconds, [&]() { PatternGraph graph(patterns[0]); });
+
+		before = g_liveBytes;
+		g_peakBytes = before;
+		PatternGraph graph(patterns[0]);
+		result.graph.bytes = g_liveBytes - before;
+		result.graph.peak = g_peakBytes - before;
+
+		ThreadPool pool(threads);
+		result.parallelGraph = measure(minSeconds, [&]() { PatternGraph graph(patterns[0], pool); });
+
+		result.vertices = graph.getNodeCount();
+		result.faces = graph.getFaceCount();
+
+		result.mesh = measure(minSeconds, [&]() { PatternMesh mesh(graph); });
+
+		before = g_liveBytes;
+		g_peakBytes = before;
+		PatternMesh mesh(graph);
+		result.mesh.bytes = g_liveBytes - before;
+		result.mesh.peak = g_peakBytes - before;
+		result.constraints = mesh.getConstraintCount();
+
+		mesh.setThreadCount(threads);
+		mesh.update(0.016f); // warm up
+		result.update = measure(minSeconds, [&]() { mesh.update(0.016f); });
+
+		return result;
+	}
+
+	double perStitch(double value, const Result & result)
+	{
+		return value / std::max<std::size_t>(result.stitches, 1);
+	}
+
+	void writeStage(std::ostream & out, const std::string & name, const Stage & stage, const Result & result, bool bLast)
+	{
+		out << "\t\t\t\"" << name << "\": { \"ns\": " << stage.ns << ", \"runs\": " << stage.runs
+			<< ", \"ns_per_stitch\": " << perStitch(stage.ns, result);
+		if (stage.bytes >= 0)
+		{
+			out << ", \"bytes\": " << stage.bytes << ", \"bytes_per_stitch\": " << perStitch((double)stage.bytes, result);
+		}
+		if (stage.peak >= 0)
+		{
+			out << ", \"peak_bytes\": " << stage.peak << ", \"peak_bytes_per_stitch\": " << perStitch((double)stage.peak, result);
+		}
+		out << " }" << (bLast ? "" : ",") << "\n";
+	}
+
+	void writeJson(std::ostream & out, const std::vector<Result> & results, unsigned int threads)
+	{
+		out << std::setprecision(6);
+		out << "{\n";
+		out << "\t\"threads\": " << threads << ",\n";
+		out << "\t\"kernel\": \"" << DistanceKernel::getString(DistanceKernel::getIsa()) << "\",\n";
+		out << "\t\"benchmarks\": [\n";
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			const Result & result = results[i];
+			out << "\t\t{\n";
+			out << "\t\t\t\"name\": \"" << result.name << "\",\n";
+			out << "\t\t\t\"source\": \"" << result.source << "\",\n";
+			out << "\t\t\t\"stitches\": " << result.stitches << ",\n";
+			out << "\t\t\t\"vertices\": " << result.vertices << ",\n";
+			out << "\t\t\t\"constraints\": " << result.constraints << ",\n";
+			out << "\t\t\t\"faces\": " << result.faces << ",\n";
+			writeStage(out, "digest", result.digest, result, false);
+			writeStage(out, "binary", result.binary, result, false);
+			writeStage(out, "graph", result.graph, result, false);
+			writeStage(out, "parallel_graph", result.parallelGraph, result, false);
+			writeStage(out, "mesh", result.mesh, result, false);
+			writeStage(out, "update", result.update, result, true);
+			out << "\t\t}" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "\t]\n";
+		out << "}\n";
+	}
+
+	void printResult(const Result & result)
+	{
+		std::cout << std::left << std::setw(14) << result.name << std::right
+			<< std::setw(9) << result.stitches << " stitches"
+			<< std::fixed << std::setprecision(1)
+			<< " | digest " << std::setw(7) << perStitch(result.digest.ns, result) << " ns/st"
+			<< " | amib " << std::setw(6) << perStitch(result.binary.ns, result) << " ns/st"
+			<< " | graph " << std::setw(6) << perStitch(result.graph.ns, result) << " ns/st "
+			<< std::setw(6) << perStitch((double)result.graph.bytes, result) << " B/st "
+			<< std::setw(6) << perStitch((double)result.graph.peak, result) << " peak"
+			<< " | pgraph " << std::setw(6) << perStitch(result.parallelGraph.ns, result) << " ns/st"
+			<< " | mesh " << std::setw(7) << perStitch(result.mesh.ns, result) << " ns/st "
+			<< std::setw(6) << perStitch((double)result.mesh.bytes, result) << " B/st "
+			<< std::setw(6) << perStitch((double)result.mesh.peak, result) << " peak"
+			<< " | update " << std::setw(6) << perStitch(result.update.ns, result) << " ns/st"
+			<< std::defaultfloat << std::endl;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	std::string data = "bin/data";
+	std::vector<unsigned int> sizes; // 1k to 1M when not given, cxxopts appends to a filled vector
+	std::string json;
+	unsigned int threads = 1;
+	double minSeconds = 0.5;
+
+	try
+	{
+		cxxopts::Options options(argv[0], " - digest, graph, mesh and update benchmark");
+		options
+			.add_options()
+			("d,data", "Directory with the .xml patterns to time", cxxopts::value<std::string>(data))
+			("s,sizes", "Stitch count of a generated sphere, repeat for several", cxxopts::value<std::vector<unsigned int>>(sizes))
+			("j,json", "Write the results as JSON to this file", cxxopts::value<std::string>(json))
+			("t,threads", "Threads used by the parallel graph build and update()", cxxopts::value<unsigned int>(threads))
+			("m,min-time", "Seconds each stage is repeated for", cxxopts::value<double>(minSeconds))
+			("h,help", "Print help")
+			;
+
+		auto result = options.parse(argc, argv);
+		if (result.count("help"))
+		{
+			std::cout << options.help() << std::endl;
+			return 0;
+		}
+		if (sizes.empty())
+		{
+			sizes = { 1000, 10000, 100000, 1000000 };
+		}
+	}
+	catch (const cxxopts::OptionException& e)
+	{
+		std::cout << "error parsing options: " << e.what() << std::endl;
+		return 1;
+	}
+
+	std::vector<Result> results;
+	try
+	{
+		// shipped patterns, in name order so runs compare line by line
+		std::vector<std::filesystem::path> files;
+		if (std::filesystem::is_directory(data))
+		{
+			for (auto & entry : std::filesystem::directory_iterator(data))
+			{
+				if (entry.path().extension() == ".xml") files.push_back(entry.path());
+			}
+		}
+		std::sort(files.begin(), files.end());
+
+		for (auto & file : files)
+		{
+			results.push_back(run(file.filename().string(), "file", file.string(), threads, minSeconds));
+			printResult(results.back());
+		}
+
+		// generated spheres go through a temporary xml file, so digest is timed on them as well
+		for (unsigned int size : sizes)
+		{
+			std::filesystem::path file = std::filesystem::temp_directory_path() / ("amigurumi_sphere_" + std::to_string(size) + ".xml");
+			PatternDef sphere = PatternGenerator::generate(PatternGenerator::withStitches(PatternGenerator::Settings(), size));
+			if (!PatternDigest::save({ sphere }, file.string()))
+			{
+				throw std::invalid_argument("Could not write " + file.string());
+			}
+
+			results.push_back(run("sphere_" + std::to_string(size), "generated", file.string(), threads, minSeconds));
+			printResult(results.back());
+
+			std::filesystem::remove(file);
+		}
+	}
+	catch (std::exception & e)
+	{
+		std::cout << "benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	if (!json.empty())
+	{
+		std::ofstream out(json);
+		writeJson(out, results, threads);
+		if (!out)
+		{
+			std::cout << "could not write " << json << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
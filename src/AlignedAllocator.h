@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace ami
+{
+	// std::allocator replacement returning blocks aligned to Alignment bytes (cache line by default),
+	// so SIMD loads of simulation buffers never straddle cache lines
+	template <class T, std::size_t Alignment = 64>
+	class AlignedAllocator
+	{
+	public:
+		typedef T value_type;
+
+		template <class U>
+		struct rebind
+		{
+			typedef AlignedAllocator<U, Alignment> other;
+		};
+
+		AlignedAllocator() {}
+
+		template <class U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+		T * allocate(std::size_t count)
+		{
+			// over allocate and keep the original pointer just before the aligned block
+			// through operator new, so replacing it (allocation counting in the benchmarks) sees these blocks too
+			void * raw = ::operator new(count * sizeof(T) + Alignment + sizeof(void *));
+
+			std::uintptr_t address = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *);
+			address = (address + Alignment - 1) & ~(std::uintptr_t)(Alignment - 1);
+
+			reinterpret_cast<void **>(address)[-1] = raw;
+			return reinterpret_cast<T *>(address);
+		}
+
+		void deallocate(T * pointer, std::size_t)
+		{
+			if (pointer) ::operator delete(reinterpret_cast<void **>(pointer)[-1]);
+		}
+
+		template <class U>
+		bool operator==(const AlignedAllocator<U, Alignment> &) const { return true; }
+		template <class U>
+		bool operator!=(const AlignedAllocator<U, Alignment> &) const { return false; }
+	};
+
+	typedef std::vector<float, AlignedAllocator<float>> AlignedFloats;
+}
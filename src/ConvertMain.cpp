@@ -0,0 +1,60 @@
+// Converts pattern files between xml and the binary .amib format (see PatternBinary)
+#include "PatternBinary.h"
+#include "PatternDigest.h"
+#include "Log.h"
+
+#include <iostream>
+#include <limits> // cxxopts.hpp uses std::numeric_limits without including it
+
+#include "cxxopts.hpp"
+
+using namespace ami;
+
+//========================================================================
+int main(int argc, char *argv[]) {
+	std::string input;
+	std::string output;
+
+	try
+	{
+		cxxopts::Options options(argv[0], " - convert patterns between xml and .amib");
+
+		options
+			.add_options()
+			("i,input", "Pattern file, xml or .amib", cxxopts::value<std::string>(input))
+			("o,output", "Output file, written as .amib unless it ends in .xml, next to the input by default", cxxopts::value<std::string>(output))
+			("h,help", "Print help")
+			;
+
+		auto result = options.parse(argc, argv);
+		if (result.count("help") || input.empty())
+		{
+			std::cout << options.help() << std::endl;
+			return result.count("help") ? 0 : 1;
+		}
+	}
+	catch (const cxxopts::OptionException& e)
+	{
+		std::cout << "error parsing options: " << e.what() << std::endl;
+		return 1;
+	}
+
+	if (output.empty())
+	{
+		output = input.substr(0, input.find_last_of('.')) + PatternBinary::getExtension();
+	}
+
+	std::vector<PatternDef> patterns = PatternDigest::digest(input);
+	if (patterns.empty())
+	{
+		LogError("PatternConvert") << "No pattern read from " << input;
+		return 1;
+	}
+
+	bool bXml = output.size() >= 4 && output.compare(output.size() - 4, 4, ".xml") == 0;
+	bool bSaved = bXml ? PatternDigest::save(patterns, output) : PatternBinary::save(patterns, output);
+	if (!bSaved) return 1;
+
+	LogNotice("PatternConvert") << input << " -> " << output << ": " << patterns.size() << " patterns";
+	return 0;
+}
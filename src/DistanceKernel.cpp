@@ -0,0 +1,264 @@
+#include "DistanceKernel.h"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define AMI_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#define AMI_TARGET_SSE2
+		#define AMI_TARGET_AVX2
+	#else
+		#define AMI_TARGET_SSE2 __attribute__((target("sse2")))
+		#define AMI_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+// All paths evaluate (dx * (distance - dist)) / dist * 0.5 in this order, as the solver did before
+// the kernels, with no fused multiply add, so every instruction set produces bit identical positions
+
+namespace ami
+{
+	namespace
+	{
+		inline void projectScalar(DistanceKernel::Positions p, IndexType a, IndexType b, float distance, bool bStretchOnly)
+		{
+			float dx = p.x[a] - p.x[b];
+			float dy = p.y[a] - p.y[b];
+			float dz = p.z[a] - p.z[b];
+			float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+			if (bStretchOnly && !(distance < dist)) return;
+			if (dist == 0.0f) dist = std::numeric_limits<float>::epsilon(); // check for zero division
+
+			float correction = distance - dist;
+			float tx = dx * correction / dist * 0.5f; // each vertex takes half of the tension
+			float ty = dy * correction / dist * 0.5f;
+			float tz = dz * correction / dist * 0.5f;
+
+			p.x[a] += tx;
+			p.y[a] += ty;
+			p.z[a] += tz;
+			p.x[b] -= tx;
+			p.y[b] -= ty;
+			p.z[b] -= tz;
+		}
+
+		template <typename Index>
+		void projectRangeScalar(DistanceKernel::Positions p, const Index * a, const Index * b, const float * distances,
+			IndexType begin, IndexType end, bool bStretchOnly)
+		{
+			for (IndexType c = begin; c < end; c++)
+			{
+				projectScalar(p, a[c], b[c], distances[c], bStretchOnly);
+			}
+		}
+
+#ifdef AMI_X86
+		template <typename Index>
+		AMI_TARGET_SSE2
+		void projectRangeSSE(DistanceKernel::Positions p, const Index * a, const Index * b, const float * distances,
+			IndexType begin, IndexType end, bool bStretchOnly)
+		{
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 epsilon = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+			const __m128 all = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+			alignas(16) float out[6][4];
+
+			IndexType c = begin;
+			for (; c + 4 <= end; c += 4)
+			{
+				const Index * ia = a + c;
+				const Index * ib = b + c;
+
+				__m128 xa = _mm_set_ps(p.x[ia[3]], p.x[ia[2]], p.x[ia[1]], p.x[ia[0]]);
+				__m128 ya = _mm_set_ps(p.y[ia[3]], p.y[ia[2]], p.y[ia[1]], p.y[ia[0]]);
+				__m128 za = _mm_set_ps(p.z[ia[3]], p.z[ia[2]], p.z[ia[1]], p.z[ia[0]]);
+				__m128 xb = _mm_set_ps(p.x[ib[3]], p.x[ib[2]], p.x[ib[1]], p.x[ib[0]]);
+				__m128 yb = _mm_set_ps(p.y[ib[3]], p.y[ib[2]], p.y[ib[1]], p.y[ib[0]]);
+				__m128 zb = _mm_set_ps(p.z[ib[3]], p.z[ib[2]], p.z[ib[1]], p.z[ib[0]]);
+				__m128 distance = _mm_loadu_ps(distances + c);
+
+				__m128 dx = _mm_sub_ps(xa, xb);
+				__m128 dy = _mm_sub_ps(ya, yb);
+				__m128 dz = _mm_sub_ps(za, zb);
+				__m128 dist = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+
+				__m128 active = bStretchOnly ? _mm_cmplt_ps(distance, dist) : all;
+				__m128 isZero = _mm_cmpeq_ps(dist, zero);
+				dist = _mm_or_ps(_mm_and_ps(isZero, epsilon), _mm_andnot_ps(isZero, dist));
+
+				__m128 correction = _mm_and_ps(_mm_sub_ps(distance, dist), active);
+				__m128 sx = _mm_mul_ps(_mm_div_ps(_mm_mul_ps(dx, correction), dist), half);
+				__m128 sy = _mm_mul_ps(_mm_div_ps(_mm_mul_ps(dy, correction), dist), half);
+				__m128 sz = _mm_mul_ps(_mm_div_ps(_mm_mul_ps(dz, correction), dist), half);
+
+				_mm_store_ps(out[0], _mm_add_ps(xa, sx));
+				_mm_store_ps(out[1], _mm_add_ps(ya, sy));
+				_mm_store_ps(out[2], _mm_add_ps(za, sz));
+				_mm_store_ps(out[3], _mm_sub_ps(xb, sx));
+				_mm_store_ps(out[4], _mm_sub_ps(yb, sy));
+				_mm_store_ps(out[5], _mm_sub_ps(zb, sz));
+
+				// no scatter: lanes never share a vertex, so write them back one by one
+				for (unsigned int lane = 0; lane < 4; lane++)
+				{
+					p.x[ia[lane]] = out[0][lane];
+					p.y[ia[lane]] = out[1][lane];
+					p.z[ia[lane]] = out[2][lane];
+					p.x[ib[lane]] = out[3][lane];
+					p.y[ib[lane]] = out[4][lane];
+					p.z[ib[lane]] = out[5][lane];
+				}
+			}
+
+			projectRangeScalar(p, a, b, distances, c, end, bStretchOnly);
+		}
+
+		AMI_TARGET_AVX2
+		inline __m256i loadIndices(const IndexType * indices)
+		{
+			if (sizeof(IndexType) == sizeof(int))
+			{
+				return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices));
+			}
+			return _mm256_set_epi32(indices[7], indices[6], indices[5], indices[4], indices[3], indices[2], indices[1], indices[0]);
+		}
+
+		// 16 bit indices are widened to the 32 bit lanes the gathers take
+		AMI_TARGET_AVX2
+		inline __m256i loadIndices(const CompactIndexType * indices)
+		{
+			return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(indices)));
+		}
+
+		template <typename Index>
+		AMI_TARGET_AVX2
+		void projectRangeAVX2(DistanceKernel::Positions p, const Index * a, const Index * b, const float * distances,
+			IndexType begin, IndexType end, bool bStretchOnly)
+		{
+			const __m256 half = _mm256_set1_ps(0.5f);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 epsilon = _mm256_set1_ps(std::numeric_limits<float>::epsilon());
+			const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+			alignas(32) float out[6][8];
+
+			IndexType c = begin;
+			for (; c + 8 <= end; c += 8)
+			{
+				const Index * ia = a + c;
+				const Index * ib = b + c;
+				__m256i indexA = loadIndices(ia);
+				__m256i indexB = loadIndices(ib);
+
+				__m256 xa = _mm256_i32gather_ps(p.x, indexA, 4);
+				__m256 ya = _mm256_i32gather_ps(p.y, indexA, 4);
+				__m256 za = _mm256_i32gather_ps(p.z, indexA, 4);
+				__m256 xb = _mm256_i32gather_ps(p.x, indexB, 4);
+				__m256 yb = _mm256_i32gather_ps(p.y, indexB, 4);
+				__m256 zb = _mm256_i32gather_ps(p.z, indexB, 4);
+				__m256 distance = _mm256_loadu_ps(distances + c);
+
+				__m256 dx = _mm256_sub_ps(xa, xb);
+				__m256 dy = _mm256_sub_ps(ya, yb);
+				__m256 dz = _mm256_sub_ps(za, zb);
+				__m256 dist = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+
+				__m256 active = bStretchOnly ? _mm256_cmp_ps(distance, dist, _CMP_LT_OQ) : all;
+				dist = _mm256_blendv_ps(dist, epsilon, _mm256_cmp_ps(dist, zero, _CMP_EQ_OQ));
+
+				__m256 correction = _mm256_and_ps(_mm256_sub_ps(distance, dist), active);
+				__m256 sx = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(dx, correction), dist), half);
+				__m256 sy = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(dy, correction), dist), half);
+				__m256 sz = _mm256_mul_ps(_mm256_div_ps(_mm256_mul_ps(dz, correction), dist), half);
+
+				_mm256_store_ps(out[0], _mm256_add_ps(xa, sx));
+				_mm256_store_ps(out[1], _mm256_add_ps(ya, sy));
+				_mm256_store_ps(out[2], _mm256_add_ps(za, sz));
+				_mm256_store_ps(out[3], _mm256_sub_ps(xb, sx));
+				_mm256_store_ps(out[4], _mm256_sub_ps(yb, sy));
+				_mm256_store_ps(out[5], _mm256_sub_ps(zb, sz));
+
+				// no scatter in AVX2: lanes never share a vertex, so write them back one by one
+				for (unsigned int lane = 0; lane < 8; lane++)
+				{
+					p.x[ia[lane]] = out[0][lane];
+					p.y[ia[lane]] = out[1][lane];
+					p.z[ia[lane]] = out[2][lane];
+					p.x[ib[lane]] = out[3][lane];
+					p.y[ib[lane]] = out[4][lane];
+					p.z[ib[lane]] = out[5][lane];
+				}
+			}
+
+			projectRangeSSE(p, a, b, distances, c, end, bStretchOnly);
+		}
+#endif
+	}
+
+	DistanceKernel::Isa DistanceKernel::getIsa()
+	{
+		static const Isa isa = []()
+		{
+#if defined(AMI_X86) && defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			int maxLeaf = info[0];
+
+			__cpuid(info, 1);
+			bool bSSE2 = (info[3] & (1 << 26)) != 0;
+			bool bOSXSave = (info[2] & (1 << 27)) != 0;
+			bool bAVX = (info[2] & (1 << 28)) != 0;
+			bool bAVX2 = false;
+			if (maxLeaf >= 7 && bOSXSave && bAVX && (_xgetbv(0) & 6) == 6) // os saves the ymm registers
+			{
+				__cpuidex(info, 7, 0);
+				bAVX2 = (info[1] & (1 << 5)) != 0;
+			}
+
+			if (bAVX2) return AVX2;
+			if (bSSE2) return SSE;
+			return SCALAR;
+#elif defined(AMI_X86)
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) return AVX2;
+			if (__builtin_cpu_supports("sse2")) return SSE;
+			return SCALAR;
+#else
+			return SCALAR;
+#endif
+		}();
+		return isa;
+	}
+
+	template <typename Index>
+	DistanceKernel::Function<Index> DistanceKernel::getFunction(Isa isa)
+	{
+		switch (isa)
+		{
+#ifdef AMI_X86
+			case AVX2: return &projectRangeAVX2<Index>;
+			case SSE: return &projectRangeSSE<Index>;
+#endif
+			default: return &projectRangeScalar<Index>;
+		}
+	}
+
+	template DistanceKernel::Function<IndexType> DistanceKernel::getFunction<IndexType>(Isa isa);
+	template DistanceKernel::Function<CompactIndexType> DistanceKernel::getFunction<CompactIndexType>(Isa isa);
+
+	std::string DistanceKernel::getString(Isa isa)
+	{
+		switch (isa)
+		{
+			case AVX2: return "AVX2";
+			case SSE: return "SSE";
+			default: return "Scalar";
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include "Types.h"
+
+namespace ami
+{
+	// Distance constraint projection over structure of arrays positions
+	// Constraints in [begin, end) must not share vertices: SIMD lanes are written back independently
+	class DistanceKernel
+	{
+	public:
+		enum Isa {
+			SCALAR,
+			SSE,
+			AVX2
+		};
+
+		struct Positions
+		{
+			float * x;
+			float * y;
+			float * z;
+		};
+
+		// bStretchOnly only projects constraints longer than their distance (soft constraints)
+		// Index is the type of the constraint ends, IndexType or CompactIndexType
+		template <typename Index>
+		using Function = void(*)(Positions positions, const Index * a, const Index * b, const float * distances,
+			IndexType begin, IndexType end, bool bStretchOnly);
+
+		// best instruction set supported by the running cpu, detected once
+		static Isa getIsa();
+
+		template <typename Index>
+		static Function<Index> getFunction(Isa isa);
+
+		template <typename Index>
+		static Function<Index> getFunction()
+		{
+			static const Function<Index> function = getFunction<Index>(getIsa());
+			return function;
+		}
+
+		static std::string getString(Isa isa);
+	};
+}
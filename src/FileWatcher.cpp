@@ -0,0 +1,60 @@
+#include "FileWatcher.h"
+
+#include <sys/stat.h>
+
+namespace ami
+{
+	FileWatcher::FileWatcher(float intervalSeconds)
+		:
+		m_interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(intervalSeconds)))
+	{}
+
+	void FileWatcher::setFile(const std::string & file)
+	{
+		m_file = file;
+		m_reported = getStamp(file);
+		m_seen = m_reported;
+		m_lastCheck = std::chrono::steady_clock::now();
+	}
+
+	bool FileWatcher::hasChanged()
+	{
+		if (m_file.empty()) return false;
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - m_lastCheck < m_interval) return false;
+		m_lastCheck = now;
+
+		Stamp stamp = getStamp(m_file);
+		bool bSettled = stamp == m_seen; // unchanged for a whole interval
+		m_seen = stamp;
+
+		// a missing file is a change in the middle of a save, not one to report
+		if (!bSettled || !stamp.bExists || stamp == m_reported) return false;
+
+		m_reported = stamp;
+		return true;
+	}
+
+	FileWatcher::Stamp FileWatcher::getStamp(const std::string & file)
+	{
+		Stamp stamp;
+#ifdef _WIN32
+		struct _stat64 info;
+		if (_stat64(file.c_str(), &info) != 0) return stamp;
+#else
+		struct stat info;
+		if (stat(file.c_str(), &info) != 0) return stamp;
+#endif
+		stamp.bExists = true;
+		stamp.size = (long long)info.st_size;
+#if defined(__APPLE__)
+		stamp.modified = (long long)info.st_mtimespec.tv_sec * 1000000000ll + info.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+		stamp.modified = (long long)info.st_mtime * 1000000000ll;
+#else
+		stamp.modified = (long long)info.st_mtim.tv_sec * 1000000000ll + info.st_mtim.tv_nsec;
+#endif
+		return stamp;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace ami
+{
+	// Polls the modification time and size of a file, cheap enough to call every frame
+	// A change is reported once the file stopped changing for one interval, so a file still being written is not read half way
+	class FileWatcher
+	{
+	public:
+		FileWatcher(float intervalSeconds = 0.25f);
+
+		// starts watching file from its current state, an empty file stops watching
+		void setFile(const std::string & file);
+
+		const std::string & getFile() const {
+			return m_file;
+		}
+
+		// true once per change, the file is only looked at once per interval
+		bool hasChanged();
+
+	private:
+		struct Stamp
+		{
+			bool bExists = false;
+			long long modified = 0;
+			long long size = 0;
+
+			bool operator==(const Stamp & other) const {
+				return bExists == other.bExists && modified == other.modified && size == other.size;
+			}
+			bool operator!=(const Stamp & other) const {
+				return !(*this == other);
+			}
+		};
+
+		static Stamp getStamp(const std::string & file);
+
+		std::string m_file;
+		std::chrono::steady_clock::duration m_interval;
+		std::chrono::steady_clock::time_point m_lastCheck;
+
+		// state last reported, and state seen at the last check
+		Stamp m_reported;
+		Stamp m_seen;
+	};
+}
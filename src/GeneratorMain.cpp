@@ -0,0 +1,78 @@
+// Command line front end of PatternGenerator, writes generated patterns as xml
+#include "PatternGenerator.h"
+#include "PatternDigest.h"
+#include "Log.h"
+#include <iostream>
+#include <limits> // cxxopts.hpp uses std::numeric_limits without including it
+
+#include "cxxopts.hpp"
+
+using namespace ami;
+
+//========================================================================
+int main(int argc, char *argv[]) {
+	PatternGenerator::Settings settings;
+	std::string shape = PatternGenerator::getString(settings.shape);
+	std::string output;
+	std::size_t stitches = 0;
+	bool bOpen = false;
+
+	try
+	{
+		cxxopts::Options options(argv[0], " - generate sphere, cylinder and cone patterns");
+
+		options
+			.add_options()
+			("shape", "sphere, cylinder or cone", cxxopts::value<std::string>(shape))
+			("r,rounds", "Increase rounds, magic ring included", cxxopts::value<unsigned int>(settings.rounds))
+			("height", "Cylinder plain rounds, or cone plain rounds after each increase", cxxopts::value<unsigned int>(settings.height))
+			("sides", "Magic ring stitches and increases per round", cxxopts::value<unsigned int>(settings.sides))
+			("open", "Leave the end open, no decreases nor finish off", cxxopts::value<bool>(bOpen))
+			("stitches", "Pick the rounds to reach at least this many stitches", cxxopts::value<std::size_t>(stitches))
+			("o,output", "Output .xml file, standard output by default", cxxopts::value<std::string>(output))
+			("h,help", "Print help")
+			;
+
+		auto result = options.parse(argc, argv);
+		if (result.count("help"))
+		{
+			std::cout << options.help() << std::endl;
+			return 0;
+		}
+
+		settings.shape = PatternGenerator::getShape(shape);
+		settings.bClosed = !bOpen;
+	}
+	catch (const cxxopts::OptionException& e)
+	{
+		std::cout << "error parsing options: " << e.what() << std::endl;
+		return 1;
+	}
+	catch (std::invalid_argument & e)
+	{
+		std::cout << e.what() << std::endl;
+		return 1;
+	}
+
+	if (stitches > 0)
+	{
+		settings = PatternGenerator::withStitches(settings, stitches);
+	}
+
+	std::vector<PatternDef> patterns = { PatternGenerator::generate(settings) };
+	if (!patterns[0].checkValid())
+	{
+		LogError("PatternGenerator") << "Generated pattern is not valid";
+		return 1;
+	}
+
+	LogNotice("PatternGenerator") << PatternGenerator::getString(settings.shape) << ", " << settings.rounds << " rounds: "
+		<< patterns[0].getStitchCount() << " stitches";
+
+	if (output.empty())
+	{
+		PatternDigest::save(patterns, std::cout);
+		return 0;
+	}
+	return PatternDigest::save(patterns, output) ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "HeadlessApp.h"
+#include "cxxopts.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace ami
+{
+	HeadlessApp::HeadlessApp(const HeadlessApp::Settings & settings)
+		:
+		m_settings(settings)
+	{}
+
+	void HeadlessApp::addOptions(cxxopts::Options & options, HeadlessApp::Settings & settings)
+	{
+		options
+			.add_options("Headless")
+			("i,input", "Pattern file to relax", cxxopts::value<std::string>(settings.input))
+			("o,output", "Output .obj file, next to the input by default", cxxopts::value<std::string>(settings.output))
+			("pattern", "Index of the pattern in the input file", cxxopts::value<unsigned int>(settings.pattern))
+			("steps", "Fixed update steps to run, 0 runs until settled", cxxopts::value<unsigned int>(settings.steps))
+			("max-steps", "Maximum steps when running until settled", cxxopts::value<unsigned int>(settings.maxSteps))
+			("tolerance", "Largest constraint length change per step of a settled mesh", cxxopts::value<float>(settings.tolerance))
+			("iterations", "Constraint solver iterations per step", cxxopts::value<unsigned int>(settings.iterations))
+			("cache", "Directory caching relaxed meshes, a pattern relaxed before with the same settings is loaded from it", cxxopts::value<std::string>(settings.cache))
+			;
+	}
+
+	int HeadlessApp::run()
+	{
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point start = Clock::now();
+
+		// only the requested pattern is parsed
+		PatternIndex patterns;
+		patterns.open(m_settings.input);
+		if (m_settings.pattern >= patterns.getPatternCount())
+		{
+			LogError("HeadlessApp") << "Pattern " << m_settings.pattern << " not found in " << m_settings.input;
+			return 1;
+		}
+
+		std::string output = m_settings.output;
+		if (output.empty())
+		{
+			output = m_settings.input.substr(0, m_settings.input.find_last_of('.')) + ".obj";
+		}
+
+		try
+		{
+			const PatternDef & pattern = patterns.getPattern(m_settings.pattern);
+
+			PatternCache cache(m_settings.cache);
+			PatternCache::Solver solver;
+			solver.parameters.solveIterations = m_settings.iterations;
+			solver.deltaTime = m_settings.deltaTime;
+			solver.steps = m_settings.steps;
+			solver.maxSteps = m_settings.maxSteps;
+			solver.tolerance = m_settings.tolerance;
+			std::uint64_t key = PatternCache::getKey(pattern, solver);
+
+			bool bUntilSettled = m_settings.steps == 0;
+			bool bSettled = false;
+			bool bCached = false;
+			unsigned int step = 0;
+
+			PatternCache::Entry entry;
+			if (cache.load(key, solver, entry))
+			{
+				bCached = true;
+				bSettled = bUntilSettled;
+			}
+			else
+			{
+				// rounds are built on as many threads as the solver gets
+				ThreadPool pool(std::max(m_settings.threads, 1u));
+				entry.graph.reset(new PatternGraph(pattern, pool));
+				entry.mesh = PatternMesh(*entry.graph, solver.parameters);
+			}
+
+			PatternMesh & mesh = entry.mesh;
+			mesh.setThreadCount(m_settings.threads);
+
+			unsigned int steps = bUntilSettled ? m_settings.maxSteps : m_settings.steps;
+			while (!bCached && step < steps && !bSettled)
+			{
+				mesh.update(m_settings.deltaTime);
+				step++;
+
+				bSettled = bUntilSettled && mesh.getMaxDeformation() < m_settings.tolerance;
+			}
+
+			if (bUntilSettled && !bSettled)
+			{
+				LogWarning("HeadlessApp") << m_settings.input << " did not settle in " << steps << " steps";
+			}
+			else if (!bCached)
+			{
+				cache.store(key, *entry.graph, mesh);
+			}
+
+			mesh.updateNormals(); // normals of the final positions
+			if (!mesh.save(output))
+			{
+				return 1;
+			}
+
+			double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			LogNotice("HeadlessApp") << m_settings.input << ": " << mesh.getVertexCount() << " vertices, " << step << " steps"
+				<< (bCached ? " (cached)" : bSettled ? " (settled)" : "") << ", " << seconds << " s -> " << output;
+		}
+		catch (std::invalid_argument & e)
+		{
+			LogError("HeadlessApp") << "Pattern graph failed: " << e.what();
+			return 1;
+		}
+
+		return 0;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+
+#include "Log.h"
+#include "PatternCache.h"
+#include "PatternIndex.h"
+#include "PatternMesh.h"
+
+namespace cxxopts
+{
+	class Options;
+}
+
+namespace ami
+{
+	// Relaxes a pattern without window or OpenGL context and writes the resulting mesh to disk
+	class HeadlessApp
+	{
+	public:
+		struct Settings
+		{
+			std::string input;
+			std::string output; // empty writes next to the input, as .obj
+			unsigned int pattern = 0; // pattern index inside the input file
+			unsigned int steps = 0; // 0 runs until settled
+			unsigned int maxSteps = 100000; // give up settling after this many steps
+			float tolerance = 1e-4f; // settled when no constraint length changes more in a step
+			float deltaTime = 0.016f;
+			unsigned int iterations = 5;
+			unsigned int threads = 1;
+			std::string cache; // directory of relaxed meshes, empty disables it
+		};
+
+		HeadlessApp(const HeadlessApp::Settings & settings);
+
+		// adds the "Headless" command line group, bound to settings (threads are left to the caller)
+		static void addOptions(cxxopts::Options & options, HeadlessApp::Settings & settings);
+
+		// returns the process exit code
+		int run();
+
+	private:
+		HeadlessApp::Settings m_settings;
+	};
+}
@@ -0,0 +1,44 @@
+// Command line entry point of the core library, relaxes patterns without openFrameworks
+#include "HeadlessApp.h"
+#include "cxxopts.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+using namespace ami;
+
+//========================================================================
+int main(int argc, char *argv[]) {
+	HeadlessApp::Settings settings;
+	settings.threads = std::max(std::thread::hardware_concurrency(), 1u);
+	bool bVerbose = false;
+
+	try
+	{
+		cxxopts::Options options(argv[0], " - relax amigurumi patterns and write them as .obj");
+
+		options
+			.add_options()
+			("t,threads", "Threads used to build the graph and by the constraint solver", cxxopts::value<unsigned int>(settings.threads))
+			("v,verbose", "Log verbose messages", cxxopts::value<bool>(bVerbose))
+			("h,help", "Print help")
+			;
+		HeadlessApp::addOptions(options, settings);
+
+		auto result = options.parse(argc, argv);
+		if (result.count("help") || settings.input.empty())
+		{
+			std::cout << options.help({ "", "Headless" }) << std::endl;
+			return result.count("help") ? 0 : 1;
+		}
+	}
+	catch (const cxxopts::OptionException& e)
+	{
+		std::cout << "error parsing options: " << e.what() << std::endl;
+		return 1;
+	}
+
+	Log::setLevel(bVerbose ? Log::LOG_VERBOSE : Log::LOG_NOTICE);
+	return HeadlessApp(settings).run();
+}
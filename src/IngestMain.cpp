@@ -0,0 +1,93 @@
+// Digests every pattern file of a directory tree in parallel and reports each file and the throughput
+#include "PatternBatch.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <limits> // cxxopts.hpp uses std::numeric_limits without including it
+#include <thread>
+
+#include "cxxopts.hpp"
+
+using namespace ami;
+
+//========================================================================
+int main(int argc, char *argv[]) {
+	std::string directory;
+	unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+	bool bQuiet = false;
+
+	try
+	{
+		cxxopts::Options options(argv[0], " - digest every pattern file of a directory");
+
+		options
+			.add_options()
+			("d,directory", "Directory searched for .xml and .amib files, subdirectories included", cxxopts::value<std::string>(directory))
+			("t,threads", "Threads digesting files, all cores by default", cxxopts::value<unsigned int>(threads))
+			("q,quiet", "Only print the failed files and the totals", cxxopts::value<bool>(bQuiet))
+			("h,help", "Print help")
+			;
+
+		auto result = options.parse(argc, argv);
+		if (result.count("help") || directory.empty())
+		{
+			std::cout << options.help() << std::endl;
+			return result.count("help") ? 0 : 1;
+		}
+	}
+	catch (const cxxopts::OptionException& e)
+	{
+		std::cout << "error parsing options: " << e.what() << std::endl;
+		return 1;
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	std::vector<std::string> files = PatternBatch::findFiles(directory);
+	if (files.empty())
+	{
+		LogError("PatternIngest") << "No pattern files in " << directory;
+		return 1;
+	}
+
+	ThreadPool pool(std::max(threads, 1u));
+	std::vector<PatternBatch::Result> results = PatternBatch::digest(files, pool);
+	double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	unsigned int failed = 0;
+	unsigned long long patterns = 0;
+	unsigned long long stitches = 0;
+	for (auto & result : results)
+	{
+		unsigned long long fileStitches = 0;
+		for (auto & pattern : result.patterns)
+		{
+			fileStitches += pattern.getStitchCount();
+		}
+		patterns += result.patterns.size();
+		stitches += fileStitches;
+
+		if (!result.error.empty())
+		{
+			failed++;
+			std::cout << "failed " << result.error << "\n";
+		}
+		else if (!bQuiet)
+		{
+			std::cout << "ok     " << result.file << ": " << result.patterns.size() << " patterns, " << fileStitches << " stitches, "
+				<< std::fixed << std::setprecision(3) << result.seconds * 1000.0 << " ms\n";
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< files.size() << " files (" << failed << " failed), " << patterns << " patterns, " << stitches << " stitches in "
+		<< wallSeconds << " s on " << pool.getThreadCount() << " threads\n"
+		<< std::setprecision(1)
+		<< files.size() / wallSeconds << " files/s, " << stitches / wallSeconds / 1e6 << " M stitches/s" << std::endl;
+
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include "Log.h"
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+
+namespace ami
+{
+	namespace
+	{
+		std::atomic<int> & currentLevel()
+		{
+			static std::atomic<int> level(Log::LOG_NOTICE);
+			return level;
+		}
+
+		// guards the handler and keeps messages from several threads from interleaving
+		std::mutex & handlerMutex()
+		{
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		Log::Handler & currentHandler()
+		{
+			static Log::Handler handler;
+			return handler;
+		}
+	}
+
+	Log::~Log()
+	{
+		if (m_level < getLevel() || m_level == LOG_SILENT) return;
+
+		std::lock_guard<std::mutex> lock(handlerMutex());
+		if (currentHandler())
+		{
+			currentHandler()(m_level, m_module, m_message.str());
+		}
+		else
+		{
+			std::cerr << "[" << getString(m_level) << "] " << m_module << ": " << m_message.str() << std::endl;
+		}
+	}
+
+	void Log::setLevel(Level level)
+	{
+		currentLevel() = level;
+	}
+
+	Log::Level Log::getLevel()
+	{
+		return static_cast<Level>(currentLevel().load());
+	}
+
+	void Log::setHandler(const Handler & handler)
+	{
+		std::lock_guard<std::mutex> lock(handlerMutex());
+		currentHandler() = handler;
+	}
+
+	std::string Log::getString(Level level)
+	{
+		switch (level)
+		{
+			case LOG_VERBOSE: return "verbose";
+			case LOG_NOTICE: return "notice";
+			case LOG_WARNING: return "warning";
+			case LOG_ERROR: return "error";
+			default: return "silent";
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+namespace ami
+{
+	// Core library logging, used like ofLog: LogVerbose("PatternMesh") << "message";
+	// Messages go to stderr unless a handler is set, the openFrameworks app routes them to ofLog
+	class Log
+	{
+	public:
+		enum Level {
+			LOG_VERBOSE,
+			LOG_NOTICE,
+			LOG_WARNING,
+			LOG_ERROR,
+			LOG_SILENT
+		};
+
+		typedef std::function<void(Level level, const std::string & module, const std::string & message)> Handler;
+
+		Log(Level level, const std::string & module) : m_level(level), m_module(module) {}
+		Log(const Log &) = delete;
+		Log & operator=(const Log &) = delete;
+
+		// the message is sent when the temporary goes out of scope
+		~Log();
+
+		template <class T>
+		Log & operator<<(const T & value)
+		{
+			m_message << value;
+			return *this;
+		}
+
+		// messages below the level are dropped, LOG_NOTICE by default
+		static void setLevel(Level level);
+		static Level getLevel();
+
+		// an empty handler writes to stderr again
+		static void setHandler(const Handler & handler);
+
+		static std::string getString(Level level);
+
+	private:
+		Level m_level;
+		std::string m_module;
+		std::ostringstream m_message;
+	};
+
+	class LogVerbose : public Log
+	{
+	public:
+		LogVerbose(const std::string & module) : Log(LOG_VERBOSE, module) {}
+	};
+
+	class LogNotice : public Log
+	{
+	public:
+		LogNotice(const std::string & module) : Log(LOG_NOTICE, module) {}
+	};
+
+	class LogWarning : public Log
+	{
+	public:
+		LogWarning(const std::string & module) : Log(LOG_WARNING, module) {}
+	};
+
+	class LogError : public Log
+	{
+	public:
+		LogError(const std::string & module) : Log(LOG_ERROR, module) {}
+	};
+}
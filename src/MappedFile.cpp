@@ -0,0 +1,117 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace ami
+{
+	MappedFile::MappedFile()
+		:
+		m_bOpen(false),
+		m_data(nullptr),
+		m_size(0)
+#ifdef _WIN32
+		,
+		m_file(INVALID_HANDLE_VALUE),
+		m_mapping(nullptr)
+#endif
+	{}
+
+	MappedFile::~MappedFile()
+	{
+		this->close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(const std::string & file)
+	{
+		this->close();
+
+		m_file = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size))
+		{
+			this->close();
+			return false;
+		}
+		m_size = (std::size_t)size.QuadPart;
+		m_bOpen = true;
+		if (m_size == 0) return true; // empty files cannot be mapped
+
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mapping) m_data = static_cast<const unsigned char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!m_data)
+		{
+			this->close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_mapping) CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+
+		m_file = INVALID_HANDLE_VALUE;
+		m_mapping = nullptr;
+		m_data = nullptr;
+		m_size = 0;
+		m_bOpen = false;
+	}
+#else
+	bool MappedFile::open(const std::string & file)
+	{
+		this->close();
+
+		int descriptor = ::open(file.c_str(), O_RDONLY);
+		if (descriptor < 0) return false;
+
+		struct stat info;
+		if (fstat(descriptor, &info) != 0)
+		{
+			::close(descriptor);
+			return false;
+		}
+		m_size = (std::size_t)info.st_size;
+
+		if (m_size > 0)
+		{
+			void * data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+			if (data == MAP_FAILED)
+			{
+				::close(descriptor);
+				m_size = 0;
+				return false;
+			}
+			m_data = static_cast<const unsigned char *>(data);
+		}
+
+		// the mapping stays valid once the descriptor is closed
+		::close(descriptor);
+		m_bOpen = true;
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data) munmap(const_cast<unsigned char *>(m_data), m_size);
+
+		m_data = nullptr;
+		m_size = 0;
+		m_bOpen = false;
+	}
+#endif
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ami
+{
+	// Read only memory mapping of a whole file, unmapped on destruction
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		MappedFile(const MappedFile &) = delete;
+		MappedFile & operator=(const MappedFile &) = delete;
+
+		// false if the file does not exist or cannot be mapped, an empty file maps to no data
+		bool open(const std::string & file);
+		void close();
+
+		bool isOpen() const {
+			return m_bOpen;
+		}
+
+		const unsigned char * getData() const {
+			return m_data;
+		}
+
+		std::size_t getSize() const {
+			return m_size;
+		}
+
+	private:
+		bool m_bOpen;
+		const unsigned char * m_data;
+		std::size_t m_size;
+#ifdef _WIN32
+		void * m_file;
+		void * m_mapping;
+#endif
+	};
+}
@@ -1,6 +1,10 @@
 #pragma once
 
-#include "ofLog.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Log.h"
 
 namespace ami
 {
@@ -26,6 +30,40 @@ namespace ami
 
 		typedef std::vector<Operation::Type> Operations;
 
+		// what one operation adds to PatternGraph: nodes and edges exactly, faces at most as degenerate ones are skipped
+		// FO adds no node and closes the round with edges that depend on its size, they are counted by PatternGraph::count
+		struct Traits
+		{
+			unsigned int nodes;
+			unsigned int edges;
+			unsigned int faces;
+		};
+
+		static constexpr Traits getTraits(Operation::Type op)
+		{
+			// indexed by Type, MR is read as INC and CH is not supported, neither reaches the graph
+			const Traits table[] = {
+				{ 1, 0, 0 }, // LP
+				{ 0, 0, 0 }, // CH
+				{ 1, 3, 2 }, // SC
+				{ 1, 2, 1 }, // INC
+				{ 1, 4, 3 }, // DEC
+				{ 0, 0, 0 }, // MR
+				{ 0, 0, 0 }  // FO
+			};
+			return table[op];
+		}
+
+		// count times the same operation
+		struct Run
+		{
+			Run() : type(LP), count(0) {}
+			Run(Operation::Type type, unsigned int count) : type(type), count(count) {}
+
+			Operation::Type type;
+			unsigned int count;
+		};
+
 		static Operation::Type getOperation(const std::string & op)
 		{
 			if (op == "LP") return LP;
@@ -35,6 +73,7 @@ namespace ami
 			if (op == "DEC") return DEC;
 			if (op == "MR") return MR;
 			if (op == "FO") return FO;
+			throw std::invalid_argument("Operation " + op + " not supported");
 		}
 		
 		static std::string getString(Operation::Type op)
@@ -48,8 +87,9 @@ namespace ami
 				case DEC: return "DEC"; break;
 				case MR: return "MR"; break;
 				case FO: return "FO"; break;
-				default: ofLogWarning("Operation") << "getString: Type not found";
+				default: LogWarning("Operation") << "getString: Type not found";
 			}
+			return "";
 		}
 
 		static unsigned int getRequiredStitches(Operation::Type op)
@@ -62,20 +102,21 @@ namespace ami
 			case INC: return 0; break;
 			case DEC: return 2; break;
 			//case MR: return 1; break;
-			default: ofLogWarning("Operation") << "RequiredStitches: Type not found";
+			default: LogWarning("Operation") << "RequiredStitches: Type not found";
 			}
+			return 0;
 		}
 
-		static Operations parseOperation(Operation::Type op, unsigned int count)
+		static Run parseOperation(Operation::Type op, unsigned int count)
 		{
 			if (op == MR)
 			{
-				return Operations(count, INC); // magic ring consists on "count inc"
+				return Run(INC, count); // magic ring consists on "count inc"
 			}
 			// for the rest its simply the operation n times
 			else
 			{
-				return Operations(count, op);
+				return Run(op, count);
 			}
 		}
 	};
@@ -0,0 +1,134 @@
+#include "PatternBatch.h"
+#include "Log.h"
+#include "PatternBinary.h"
+#include "PatternDigest.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <dirent.h>
+	#include <sys/stat.h>
+#endif
+
+namespace ami
+{
+	namespace
+	{
+		bool hasExtension(const std::string & file, const std::string & extension)
+		{
+			if (file.size() < extension.size()) return false;
+			return std::equal(extension.begin(), extension.end(), file.end() - extension.size(), [](char a, char b)
+			{
+				return std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+			});
+		}
+
+		bool isPatternFile(const std::string & file)
+		{
+			return hasExtension(file, ".xml") || hasExtension(file, PatternBinary::getExtension());
+		}
+
+#ifdef _WIN32
+		void listFiles(const std::string & directory, std::vector<std::string> & files)
+		{
+			WIN32_FIND_DATAA data;
+			HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+			if (find == INVALID_HANDLE_VALUE)
+			{
+				LogWarning("PatternBatch") << "Could not list " << directory;
+				return;
+			}
+
+			do
+			{
+				std::string name = data.cFileName;
+				if (name == "." || name == "..") continue;
+
+				std::string path = directory + "\\" + name;
+				if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue; // links could loop
+				if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				{
+					listFiles(path, files);
+				}
+				else if (isPatternFile(name))
+				{
+					files.push_back(path);
+				}
+			} while (FindNextFileA(find, &data));
+
+			FindClose(find);
+		}
+#else
+		void listFiles(const std::string & directory, std::vector<std::string> & files)
+		{
+			DIR * dir = opendir(directory.c_str());
+			if (!dir)
+			{
+				LogWarning("PatternBatch") << "Could not list " << directory;
+				return;
+			}
+
+			while (dirent * entry = readdir(dir))
+			{
+				std::string name = entry->d_name;
+				if (name == "." || name == "..") continue;
+
+				std::string path = directory + "/" + name;
+				struct stat info;
+				if (lstat(path.c_str(), &info) != 0) continue; // links are not followed, they could loop
+				if (S_ISDIR(info.st_mode))
+				{
+					listFiles(path, files);
+				}
+				else if (S_ISREG(info.st_mode) && isPatternFile(name))
+				{
+					files.push_back(path);
+				}
+			}
+
+			closedir(dir);
+		}
+#endif
+	}
+
+	std::vector<std::string> PatternBatch::findFiles(const std::string & directory)
+	{
+		std::vector<std::string> files;
+		listFiles(directory, files);
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
+	std::vector<PatternBatch::Result> PatternBatch::digest(const std::vector<std::string> & files, ThreadPool & pool)
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		// every result is written by the one thread that took its file
+		std::vector<Result> results(files.size());
+		pool.parallelForEach(0, (unsigned int)files.size(), 1, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				Result & result = results[i];
+				result.file = files[i];
+
+				Clock::time_point start = Clock::now();
+				result.patterns = PatternDigest::digest(files[i], result.error);
+				if (result.error.empty() && result.patterns.empty())
+				{
+					result.error = files[i] + " has no patterns";
+				}
+				result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+			}
+		});
+
+		return results;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "PatternDef.h"
+#include "ThreadPool.h"
+
+namespace ami
+{
+	// Digests many pattern files at once, files are spread over a ThreadPool with work stealing
+	// so a few large files do not leave the other threads idle
+	class PatternBatch
+	{
+	public:
+		struct Result
+		{
+			std::string file;
+			std::vector<PatternDef> patterns;
+			// empty if the file was digested
+			std::string error;
+			// time spent digesting this file, on whatever thread took it
+			double seconds = 0.0;
+		};
+
+		// pattern files (.xml and .amib) under directory and its subdirectories, sorted
+		static std::vector<std::string> findFiles(const std::string & directory);
+
+		// one result per file, in the order of files
+		static std::vector<Result> digest(const std::vector<std::string> & files, ThreadPool & pool);
+	};
+}
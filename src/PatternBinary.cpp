@@ -0,0 +1,199 @@
+#include "PatternBinary.h"
+#include "Log.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace ami
+{
+	namespace
+	{
+		const char magic[4] = { 'A', 'M', 'I', 'B' };
+		const std::uint32_t byteOrderMark = 0x01020304;
+
+		template <class T>
+		void write(std::ostream & out, const std::vector<T> & table)
+		{
+			out.write(reinterpret_cast<const char *>(table.data()), table.size() * sizeof(T));
+		}
+	}
+
+	bool PatternBinary::open(const std::string & file)
+	{
+		m_header = Header();
+		m_error.clear();
+		if (!m_file.open(file))
+		{
+			m_error = "File " + file + " not found";
+			return false;
+		}
+
+		// only the header is read, the tables are used where they are mapped
+		if (m_file.getSize() < sizeof(Header))
+		{
+			m_error = file + " is too short for a pattern binary";
+			m_file.close();
+			return false;
+		}
+		std::memcpy(&m_header, m_file.getData(), sizeof(Header));
+
+		std::string error;
+		if (std::memcmp(m_header.magic, magic, sizeof(magic)) != 0) error = "not a pattern binary";
+		else if (m_header.byteOrder != byteOrderMark) error = "written with another byte order";
+		else if (m_header.version != Version) error = "version " + std::to_string(m_header.version) + ", expected " + std::to_string(Version);
+		else
+		{
+			unsigned long long size = sizeof(Header)
+				+ (m_header.patternCount + 1ull) * sizeof(std::uint32_t)
+				+ (m_header.roundCount + 1ull) * sizeof(std::uint32_t)
+				+ (unsigned long long)m_header.groupCount * sizeof(Group)
+				+ (unsigned long long)m_header.runCount * sizeof(Run);
+			if (size != m_file.getSize()) error = "size does not match its header";
+		}
+		if (!error.empty())
+		{
+			m_error = file + ": " + error;
+			m_header = Header();
+			m_file.close();
+			return false;
+		}
+
+		const unsigned char * data = m_file.getData() + sizeof(Header);
+		m_patternRounds = reinterpret_cast<const std::uint32_t *>(data);
+		data += (m_header.patternCount + 1) * sizeof(std::uint32_t);
+		m_roundGroups = reinterpret_cast<const std::uint32_t *>(data);
+		data += (m_header.roundCount + 1) * sizeof(std::uint32_t);
+		m_groups = reinterpret_cast<const Group *>(data);
+		data += m_header.groupCount * sizeof(Group);
+		m_runs = reinterpret_cast<const Run *>(data);
+
+		return true;
+	}
+
+	PatternDef PatternBinary::getPattern(unsigned int pattern) const
+	{
+		if (pattern >= m_header.patternCount)
+		{
+			throw std::out_of_range("Pattern " + std::to_string(pattern) + " not found");
+		}
+
+		// offsets are checked as they are used, a corrupt file never reads outside the mapping
+		std::uint32_t roundBegin = m_patternRounds[pattern];
+		std::uint32_t roundEnd = m_patternRounds[pattern + 1];
+		if (roundBegin > roundEnd || roundEnd > m_header.roundCount)
+		{
+			throw std::invalid_argument("Corrupt round offsets for pattern " + std::to_string(pattern));
+		}
+
+		PatternDef def;
+		def.getRounds().clear(); // the stored rounds already start with the loop
+		def.getRounds().reserve(roundEnd - roundBegin);
+
+		std::vector<Operation::Run> runs;
+		for (std::uint32_t round = roundBegin; round < roundEnd; round++)
+		{
+			std::uint32_t groupBegin = m_roundGroups[round];
+			std::uint32_t groupEnd = m_roundGroups[round + 1];
+			if (groupBegin > groupEnd || groupEnd > m_header.groupCount)
+			{
+				throw std::invalid_argument("Corrupt group offsets for round " + std::to_string(round));
+			}
+
+			PatternDef::Round operations;
+			for (std::uint32_t group = groupBegin; group < groupEnd; group++)
+			{
+				const Group & stored = m_groups[group];
+				if (stored.begin > stored.end || stored.end > m_header.runCount)
+				{
+					throw std::invalid_argument("Corrupt run offsets for group " + std::to_string(group));
+				}
+
+				runs.clear();
+				for (std::uint32_t run = stored.begin; run < stored.end; run++)
+				{
+					if (m_runs[run].type > Operation::Type::FO)
+					{
+						throw std::invalid_argument("Unknown operation in run " + std::to_string(run));
+					}
+					runs.push_back(Operation::Run(Operation::Type(m_runs[run].type), m_runs[run].count));
+				}
+				operations.addGroup(runs, stored.repeat);
+			}
+			def.addRound(operations);
+		}
+
+		return def;
+	}
+
+	std::vector<PatternDef> PatternBinary::getPatterns() const
+	{
+		std::vector<PatternDef> patterns;
+		patterns.reserve(m_header.patternCount);
+		for (unsigned int pattern = 0; pattern < m_header.patternCount; pattern++)
+		{
+			patterns.push_back(this->getPattern(pattern));
+		}
+		return patterns;
+	}
+
+	bool PatternBinary::save(const std::vector<PatternDef> & patterns, const std::string & file)
+	{
+		std::vector<std::uint32_t> patternRounds(1, 0);
+		std::vector<std::uint32_t> roundGroups(1, 0);
+		std::vector<Group> groups;
+		std::vector<Run> runs;
+
+		for (auto & pattern : patterns)
+		{
+			for (auto & round : pattern.getRounds())
+			{
+				// groups of a round index its own runs, here they index the whole run table
+				std::uint32_t firstRun = (std::uint32_t)runs.size();
+				for (auto & group : round.getGroups())
+				{
+					Group stored = { firstRun + group.begin, firstRun + group.end, group.repeat };
+					groups.push_back(stored);
+				}
+				for (auto & run : round.getRuns())
+				{
+					Run stored = { (std::uint32_t)run.type, run.count };
+					runs.push_back(stored);
+				}
+				roundGroups.push_back((std::uint32_t)groups.size());
+			}
+			patternRounds.push_back((std::uint32_t)roundGroups.size() - 1);
+		}
+
+		Header header = Header();
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.version = Version;
+		header.byteOrder = byteOrderMark;
+		header.patternCount = (std::uint32_t)patterns.size();
+		header.roundCount = (std::uint32_t)roundGroups.size() - 1;
+		header.groupCount = (std::uint32_t)groups.size();
+		header.runCount = (std::uint32_t)runs.size();
+
+		std::ofstream out(file, std::ios::binary);
+		if (!out)
+		{
+			LogError("PatternBinary") << "Could not write " << file;
+			return false;
+		}
+		out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+		write(out, patternRounds);
+		write(out, roundGroups);
+		write(out, groups);
+		write(out, runs);
+
+		return bool(out);
+	}
+
+	bool PatternBinary::isBinary(const std::string & file)
+	{
+		std::ifstream in(file, std::ios::binary);
+		char start[sizeof(magic)] = {};
+		in.read(start, sizeof(start));
+		return in && std::memcmp(start, magic, sizeof(magic)) == 0;
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "PatternDef.h"
+
+namespace ami
+{
+	// Binary pattern file (.amib), memory mapped and read in place: opening only checks the header
+	// Layout, all fields uint32 in the byte order of the writer (checked on open):
+	//   header          magic "AMIB", version, byte order mark, pattern, round, group and run counts, reserved
+	//   patternRounds   patternCount + 1 offsets, rounds of pattern p are [patternRounds[p], patternRounds[p + 1])
+	//   roundGroups     roundCount + 1 offsets, groups of round r are [roundGroups[r], roundGroups[r + 1])
+	//   groups          groupCount x (begin run, end run, repeat)
+	//   runs            runCount x (operation, count)
+	// Rounds are stored as in PatternDef, the starting loop included
+	// A host of the other byte order rejects the file, so .amib files are not portable across byte orders, xml is
+	class PatternBinary
+	{
+	public:
+		static const std::uint32_t Version = 1;
+		static const char * getExtension() {
+			return ".amib";
+		}
+
+		PatternBinary() {}
+
+		// false if the file is missing, not a pattern binary, of another version or truncated, see getError
+		bool open(const std::string & file);
+
+		// why the last open failed
+		const std::string & getError() const {
+			return m_error;
+		}
+
+		bool isOpen() const {
+			return m_file.isOpen();
+		}
+
+		unsigned int getPatternCount() const {
+			return m_header.patternCount;
+		}
+
+		// O(size of the pattern), other patterns are not touched
+		// throws std::out_of_range for a missing pattern and std::invalid_argument for corrupt tables
+		PatternDef getPattern(unsigned int pattern) const;
+
+		std::vector<PatternDef> getPatterns() const;
+
+		static bool save(const std::vector<PatternDef> & patterns, const std::string & file);
+
+		// true if the file starts with the binary magic, whatever its extension
+		static bool isBinary(const std::string & file);
+
+	private:
+		struct Header
+		{
+			char magic[4];
+			std::uint32_t version;
+			std::uint32_t byteOrder;
+			std::uint32_t patternCount;
+			std::uint32_t roundCount;
+			std::uint32_t groupCount;
+			std::uint32_t runCount;
+			std::uint32_t reserved;
+		};
+
+		struct Group
+		{
+			std::uint32_t begin;
+			std::uint32_t end;
+			std::uint32_t repeat;
+		};
+
+		struct Run
+		{
+			std::uint32_t type;
+			std::uint32_t count;
+		};
+
+		MappedFile m_file;
+		Header m_header = Header();
+		std::string m_error;
+
+		// tables inside the mapping
+		const std::uint32_t * m_patternRounds = nullptr;
+		const std::uint32_t * m_roundGroups = nullptr;
+		const Group * m_groups = nullptr;
+		const Run * m_runs = nullptr;
+	};
+}
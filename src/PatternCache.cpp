@@ -0,0 +1,439 @@
+#include "PatternCache.h"
+#include "Log.h"
+#include "MappedFile.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace ami
+{
+	namespace
+	{
+		const char magic[4] = { 'A', 'M', 'I', 'C' };
+		const std::uint32_t byteOrderMark = 0x01020304;
+
+		struct Header
+		{
+			char magic[4];
+			std::uint32_t version;
+			std::uint32_t byteOrder;
+			std::uint32_t reserved;
+			std::uint64_t key;
+			std::uint32_t nodeCount;
+			std::uint32_t edgeCount;
+			std::uint32_t faceCount;
+			std::uint32_t reserved2;
+		};
+
+		// fixed width records, whatever the in memory layout of the graph
+		struct StoredNode
+		{
+			std::uint32_t last;
+			std::uint32_t under;
+			std::uint32_t next;
+			std::uint32_t op;
+		};
+
+		struct StoredEdge
+		{
+			std::uint32_t from;
+			std::uint32_t to;
+			float distance;
+		};
+
+		struct StoredFace
+		{
+			std::uint32_t ids[3];
+		};
+
+		// FNV-1a, stable across runs and platforms of the same byte order
+		class Hash
+		{
+		public:
+			template <class T>
+			void add(const T & value)
+			{
+				const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&value);
+				for (std::size_t i = 0; i < sizeof(T); i++)
+				{
+					m_hash = (m_hash ^ bytes[i]) * 1099511628211ull;
+				}
+			}
+
+			std::uint64_t get() const {
+				return m_hash;
+			}
+
+		private:
+			std::uint64_t m_hash = 14695981039346656037ull;
+		};
+
+		// adds runs merged with the previous one when they repeat its operation,
+		// so every encoding of the same operations hashes the same
+		class RunHash
+		{
+		public:
+			RunHash(Hash & hash) : m_hash(hash) {}
+
+			void add(Operation::Type type, unsigned int count)
+			{
+				if (count == 0) return;
+				if (m_count > 0 && type == m_type)
+				{
+					m_count += count;
+					return;
+				}
+				flush();
+				m_type = type;
+				m_count = count;
+			}
+
+			void flush()
+			{
+				if (m_count == 0) return;
+				m_hash.add(std::uint32_t(m_type));
+				m_hash.add(m_count);
+				m_count = 0;
+			}
+
+		private:
+			Hash & m_hash;
+			Operation::Type m_type = Operation::Type::LP;
+			std::uint64_t m_count = 0;
+		};
+
+		// the node, edge and face records of an entry, data is left after them, error names the first corrupt one
+		template <typename Index>
+		BasicPatternGraph<Index> readGraph(const unsigned char * & data, std::uint32_t nodeCount, const Header & header, std::string & error)
+		{
+			typename BasicPatternGraph<Index>::Nodes nodes;
+			nodes.last.resize(nodeCount);
+			nodes.under.resize(nodeCount);
+			nodes.next.resize(nodeCount);
+			nodes.op.resize(nodeCount);
+			for (std::uint32_t n = 0; n < nodeCount; n++, data += sizeof(StoredNode))
+			{
+				StoredNode stored;
+				std::memcpy(&stored, data, sizeof(StoredNode));
+				if (stored.last >= nodeCount || stored.under >= nodeCount || stored.next >= nodeCount || stored.op > Operation::Type::FO)
+				{
+					error = "corrupt node " + std::to_string(n);
+					break;
+				}
+				nodes.last[n] = stored.last;
+				nodes.under[n] = stored.under;
+				nodes.next[n] = stored.next;
+				nodes.op[n] = Operation::Type(stored.op);
+			}
+
+			std::vector<typename BasicPatternGraph<Index>::Edge> edges(error.empty() ? header.edgeCount : 0);
+			for (std::size_t e = 0; e < edges.size(); e++, data += sizeof(StoredEdge))
+			{
+				StoredEdge stored;
+				std::memcpy(&stored, data, sizeof(StoredEdge));
+				if (stored.from >= nodeCount || stored.to >= nodeCount || !std::isfinite(stored.distance))
+				{
+					error = "corrupt edge " + std::to_string(e);
+					break;
+				}
+				edges[e].from = stored.from;
+				edges[e].to = stored.to;
+				edges[e].distance = stored.distance;
+			}
+
+			std::vector<typename BasicPatternGraph<Index>::Face> faces(error.empty() ? header.faceCount : 0);
+			for (std::size_t f = 0; f < faces.size(); f++, data += sizeof(StoredFace))
+			{
+				StoredFace stored;
+				std::memcpy(&stored, data, sizeof(StoredFace));
+				for (unsigned int corner = 0; corner < 3; corner++)
+				{
+					if (stored.ids[corner] >= nodeCount) error = "corrupt face " + std::to_string(f);
+					faces[f].ids[corner] = stored.ids[corner];
+				}
+				if (!error.empty()) break;
+			}
+
+			return BasicPatternGraph<Index>(std::move(nodes), std::move(edges), std::move(faces));
+		}
+
+		// unique per process and per call, concurrent writers of the same key never share it
+		std::string getTemporaryFile(const std::string & file)
+		{
+			static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+			unsigned long process = GetCurrentProcessId();
+#else
+			unsigned long process = (unsigned long)getpid();
+#endif
+			return file + "." + std::to_string(process) + "." + std::to_string(counter++) + ".tmp";
+		}
+
+		// replaces an existing target in one step, readers see either the old or the new file
+		bool replaceFile(const std::string & from, const std::string & to)
+		{
+#ifdef _WIN32
+			return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+			return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+		}
+
+		bool makeDirectories(const std::string & directory)
+		{
+			for (std::size_t end = 1; end <= directory.size(); end++)
+			{
+				if (end < directory.size() && directory[end] != '/' && directory[end] != '\\') continue;
+
+				std::string path = directory.substr(0, end);
+#ifdef _WIN32
+				_mkdir(path.c_str());
+#else
+				mkdir(path.c_str(), 0755);
+#endif
+			}
+
+#ifdef _WIN32
+			struct _stat info;
+			return _stat(directory.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR);
+#else
+			struct stat info;
+			return stat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+		}
+
+		template <class T>
+		void write(std::ostream & out, const T * data, std::size_t count)
+		{
+			out.write(reinterpret_cast<const char *>(data), count * sizeof(T));
+		}
+	}
+
+	// Hash::add takes it by reference, so it needs a definition
+	const std::uint32_t PatternCache::Version;
+
+	PatternCache::PatternCache(const std::string & directory)
+		:
+		m_directory(directory)
+	{}
+
+	std::uint64_t PatternCache::getKey(const PatternDef & pattern, const PatternCache::Solver & solver)
+	{
+		Hash hash;
+		hash.add(Version);
+
+		for (auto & round : pattern.getRounds())
+		{
+			// the operations of the round in order, whatever their runs and repeats
+			RunHash runs(hash);
+			for (auto & group : round.getGroups())
+			{
+				for (unsigned int repeat = 0; repeat < group.repeat; repeat++)
+				{
+					for (unsigned int run = group.begin; run < group.end; run++)
+					{
+						runs.add(round.getRuns()[run].type, round.getRuns()[run].count);
+					}
+				}
+			}
+			runs.flush();
+			hash.add(std::uint32_t(0xFFFFFFFF)); // end of round
+		}
+
+		hash.add(solver.parameters.pointDistance);
+		hash.add(solver.parameters.damping);
+		hash.add(solver.parameters.expansion);
+		hash.add(solver.parameters.solveIterations);
+		hash.add(solver.deltaTime);
+		hash.add(solver.steps);
+		// settling only matters when running until settled
+		if (solver.steps == 0)
+		{
+			hash.add(solver.maxSteps);
+			hash.add(solver.tolerance);
+		}
+		return hash.get();
+	}
+
+	std::string PatternCache::getFile(std::uint64_t key) const
+	{
+		char name[17];
+		std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+		return m_directory + "/" + name + ".amic";
+	}
+
+	bool PatternCache::load(std::uint64_t key, const PatternCache::Solver & solver, PatternCache::Entry & entry) const
+	{
+		if (!this->isEnabled()) return false;
+
+		std::string file = getFile(key);
+		MappedFile mapped;
+		if (!mapped.open(file))
+		{
+			return false;
+		}
+
+		std::string error;
+		Header header;
+		if (mapped.getSize() < sizeof(Header))
+		{
+			error = "too short";
+		}
+		else
+		{
+			std::memcpy(&header, mapped.getData(), sizeof(Header));
+
+			unsigned long long size = sizeof(Header)
+				+ (unsigned long long)header.nodeCount * (sizeof(StoredNode) + 3 * sizeof(float))
+				+ (unsigned long long)header.edgeCount * sizeof(StoredEdge)
+				+ (unsigned long long)header.faceCount * sizeof(StoredFace);
+
+			if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) error = "not a cache entry";
+			else if (header.version != Version || header.byteOrder != byteOrderMark) error = "written by another version";
+			else if (header.key != key) error = "key does not match";
+			else if (size != mapped.getSize()) error = "size does not match its header";
+		}
+		if (!error.empty())
+		{
+			LogWarning("PatternCache") << "Ignoring " << file << ": " << error;
+			return false;
+		}
+
+		// copied out of the mapping, every index checked so a corrupt entry is never used
+		const unsigned char * data = mapped.getData() + sizeof(Header);
+		std::uint32_t nodeCount = header.nodeCount;
+
+		// the graph gets the width PatternGraph picks for its node count
+		std::unique_ptr<PatternGraph> graph;
+		if (PatternGraph::fitsCompact(nodeCount))
+		{
+			graph.reset(new PatternGraph(readGraph<CompactIndexType>(data, nodeCount, header, error)));
+		}
+		else
+		{
+			graph.reset(new PatternGraph(readGraph<IndexType>(data, nodeCount, header, error)));
+		}
+
+		AlignedFloats positions[3];
+		if (error.empty())
+		{
+			for (auto & axis : positions)
+			{
+				axis.resize(nodeCount);
+				if (nodeCount > 0) std::memcpy(axis.data(), data, nodeCount * sizeof(float));
+				data += nodeCount * sizeof(float);
+			}
+		}
+
+		if (!error.empty())
+		{
+			LogWarning("PatternCache") << "Ignoring " << file << ": " << error;
+			return false;
+		}
+
+		entry.graph = std::move(graph);
+		entry.mesh = PatternMesh(*entry.graph, solver.parameters);
+		entry.mesh.setPositions(positions[0], positions[1], positions[2]);
+
+		LogVerbose("PatternCache") << "Loaded " << file;
+		return true;
+	}
+
+	bool PatternCache::store(std::uint64_t key, const PatternGraph & graph, const PatternMesh & mesh) const
+	{
+		if (!this->isEnabled()) return false;
+
+		if (mesh.getVertexCount() != graph.getNodeCount())
+		{
+			LogError("PatternCache") << "The mesh was not built from this graph";
+			return false;
+		}
+		if (!makeDirectories(m_directory))
+		{
+			LogError("PatternCache") << "Could not create " << m_directory;
+			return false;
+		}
+
+		// records are 32 bit whatever the width of the graph
+		std::vector<StoredNode> nodes;
+		std::vector<StoredEdge> edges;
+		std::vector<StoredFace> faces;
+		graph.withGraph([&](const auto & built)
+		{
+			const auto & graphNodes = built.getNodes();
+			nodes.reserve(graphNodes.size());
+			for (IndexType n = 0; n < graphNodes.size(); n++)
+			{
+				StoredNode stored = { graphNodes.last[n], graphNodes.under[n], graphNodes.next[n], std::uint32_t(graphNodes.op[n]) };
+				nodes.push_back(stored);
+			}
+
+			edges.reserve(built.getEdges().size());
+			for (auto & edge : built.getEdges())
+			{
+				StoredEdge stored = { edge.from, edge.to, edge.distance };
+				edges.push_back(stored);
+			}
+
+			faces.reserve(built.getFaces().size());
+			for (auto & face : built.getFaces())
+			{
+				StoredFace stored = { { face.ids[0], face.ids[1], face.ids[2] } };
+				faces.push_back(stored);
+			}
+		});
+
+		Header header = Header();
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.version = Version;
+		header.byteOrder = byteOrderMark;
+		header.key = key;
+		header.nodeCount = (std::uint32_t)nodes.size();
+		header.edgeCount = (std::uint32_t)edges.size();
+		header.faceCount = (std::uint32_t)faces.size();
+
+		std::string file = getFile(key);
+		std::string temporary = getTemporaryFile(file);
+		{
+			std::ofstream out(temporary, std::ios::binary);
+			write(out, &header, 1);
+			write(out, nodes.data(), nodes.size());
+			write(out, edges.data(), edges.size());
+			write(out, faces.data(), faces.size());
+			write(out, mesh.getX().data(), mesh.getX().size());
+			write(out, mesh.getY().data(), mesh.getY().size());
+			write(out, mesh.getZ().data(), mesh.getZ().size());
+			if (!out)
+			{
+				LogError("PatternCache") << "Could not write " << temporary;
+				std::remove(temporary.c_str());
+				return false;
+			}
+		}
+
+		if (!replaceFile(temporary, file))
+		{
+			LogError("PatternCache") << "Could not write " << file;
+			std::remove(temporary.c_str());
+			return false;
+		}
+
+		LogVerbose("PatternCache") << "Stored " << file;
+		return true;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "PatternDef.h"
+#include "PatternGraph.h"
+#include "PatternMesh.h"
+
+namespace ami
+{
+	// On disk cache of built graphs and relaxed positions, one file per key in a directory
+	// The key hashes the pattern (as the operations it expands to, so any run or repeat encoding of it hits)
+	// and every solver setting the relaxed shape depends on, a change of either is a different entry
+	class PatternCache
+	{
+	public:
+		static const std::uint32_t Version = 1;
+
+		// how the cached positions were relaxed
+		struct Solver
+		{
+			PatternMesh::Parameters parameters;
+			float deltaTime = 0.016f;
+			unsigned int steps = 0; // 0 runs until settled
+			unsigned int maxSteps = 100000; // give up settling after this many steps
+			float tolerance = 1e-4f; // settled when no constraint length changes more in a step
+		};
+
+		// a cached graph with the mesh built from it, positions already relaxed
+		struct Entry
+		{
+			std::unique_ptr<PatternGraph> graph;
+			PatternMesh mesh;
+		};
+
+		// an empty directory disables the cache: nothing is found and nothing stored
+		PatternCache(const std::string & directory = "");
+
+		bool isEnabled() const {
+			return !m_directory.empty();
+		}
+
+		static std::uint64_t getKey(const PatternDef & pattern, const Solver & solver);
+
+		// false if there is no entry or it is unreadable (the file is then ignored and overwritten by the next store)
+		bool load(std::uint64_t key, const Solver & solver, Entry & entry) const;
+
+		// the graph and the current positions of mesh, written to a temporary file first so readers never see half an entry
+		bool store(std::uint64_t key, const PatternGraph & graph, const PatternMesh & mesh) const;
+
+		std::string getFile(std::uint64_t key) const;
+
+	private:
+		std::string m_directory;
+	};
+}
@@ -0,0 +1,153 @@
+#include "PatternConstraints.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace ami
+{
+	template <typename Index>
+	void BasicConstraints<Index>::add(IndexType a, IndexType b, float distance)
+	{
+		if (a == b) return; // a vertex is always at distance 0 of itself
+		if (std::max(a, b) > std::numeric_limits<Index>::max())
+		{
+			throw std::invalid_argument("Constraint vertex out of the index range");
+		}
+
+		m_staged.push_back({ Index(std::min(a, b)), Index(std::max(a, b)), distance });
+	}
+
+	template <typename Index>
+	void BasicConstraints<Index>::build(IndexType vertexCount)
+	{
+		// sort by pair, tightest distance first
+		std::sort(m_staged.begin(), m_staged.end(), [](const Staged & a, const Staged & b)
+		{
+			if (a.a != b.a) return a.a < b.a;
+			if (a.b != b.b) return a.b < b.b;
+			return a.distance < b.distance;
+		});
+		// SC, INC and DEC share sides with their neighbours, and FO may close an existing edge:
+		// keep a single constraint per pair, the tightest one
+		m_staged.erase(std::unique(m_staged.begin(), m_staged.end(), [](const Staged & a, const Staged & b)
+		{
+			return a.a == b.a && a.b == b.b;
+		}), m_staged.end());
+
+		m_a.resize(m_staged.size());
+		m_b.resize(m_staged.size());
+		m_distances.resize(m_staged.size());
+		for (IndexType constraint = 0; constraint < m_staged.size(); constraint++)
+		{
+			m_a[constraint] = m_staged[constraint].a;
+			m_b[constraint] = m_staged[constraint].b;
+			m_distances[constraint] = m_staged[constraint].distance;
+		}
+
+		m_staged.clear();
+		m_staged.shrink_to_fit();
+
+		buildAdjacency(vertexCount);
+		buildColors(vertexCount);
+	}
+
+	template <typename Index>
+	void BasicConstraints<Index>::buildAdjacency(IndexType vertexCount)
+	{
+		// count neighbours per vertex, prefix sum into offsets, then scatter
+		std::vector<IndexType> & offsets = m_adjacency.m_offsets;
+		std::vector<Index> & neighbours = m_adjacency.m_neighbours;
+
+		offsets.assign(vertexCount + 1, 0);
+		neighbours.resize(m_a.size() * 2);
+
+		for (IndexType constraint = 0; constraint < m_a.size(); constraint++)
+		{
+			offsets[m_a[constraint] + 1]++;
+			offsets[m_b[constraint] + 1]++;
+		}
+		for (IndexType vertex = 0; vertex < vertexCount; vertex++)
+		{
+			offsets[vertex + 1] += offsets[vertex];
+		}
+
+		std::vector<IndexType> cursor(offsets.begin(), offsets.end() - 1);
+		for (IndexType constraint = 0; constraint < m_a.size(); constraint++)
+		{
+			neighbours[cursor[m_a[constraint]]++] = m_b[constraint];
+			neighbours[cursor[m_b[constraint]]++] = m_a[constraint];
+		}
+	}
+
+	template <typename Index>
+	void BasicConstraints<Index>::buildColors(IndexType vertexCount)
+	{
+		// greedy edge coloring in edge order: every constraint takes the lowest color free at both ends
+		// it needs at most 2 * maxDegree - 1 colors, tracked as one bit mask per vertex
+		IndexType maxDegree = 0;
+		for (IndexType vertex = 0; vertex < vertexCount; vertex++)
+		{
+			maxDegree = std::max(maxDegree, m_adjacency.end(vertex) - m_adjacency.begin(vertex));
+		}
+		const unsigned int words = std::max<IndexType>(1, (2 * maxDegree + 63) / 64);
+
+		std::vector<uint64_t> used(vertexCount * words, 0);
+		std::vector<unsigned int> colors(m_a.size());
+		unsigned int colorCount = 0;
+
+		for (IndexType constraint = 0; constraint < m_a.size(); constraint++)
+		{
+			const uint64_t * usedA = &used[m_a[constraint] * words];
+			const uint64_t * usedB = &used[m_b[constraint] * words];
+
+			unsigned int color = 0;
+			for (unsigned int word = 0; word < words; word++)
+			{
+				uint64_t free = ~(usedA[word] | usedB[word]);
+				if (free != 0)
+				{
+					unsigned int bit = 0;
+					while (!(free & (uint64_t(1) << bit))) bit++;
+					color = word * 64 + bit;
+					break;
+				}
+			}
+
+			used[m_a[constraint] * words + color / 64] |= uint64_t(1) << (color % 64);
+			used[m_b[constraint] * words + color / 64] |= uint64_t(1) << (color % 64);
+			colors[constraint] = color;
+			colorCount = std::max(colorCount, color + 1);
+		}
+
+		// regroup the edge list by color, keeping the edge order inside each color
+		m_colorOffsets.assign(colorCount + 1, 0);
+		for (unsigned int color : colors)
+		{
+			m_colorOffsets[color + 1]++;
+		}
+		for (unsigned int color = 0; color < colorCount; color++)
+		{
+			m_colorOffsets[color + 1] += m_colorOffsets[color];
+		}
+
+		std::vector<Index> a(m_a.size());
+		std::vector<Index> b(m_b.size());
+		std::vector<float> distances(m_distances.size());
+		std::vector<IndexType> cursor(m_colorOffsets.begin(), m_colorOffsets.end() - 1);
+		for (IndexType constraint = 0; constraint < m_a.size(); constraint++)
+		{
+			IndexType slot = cursor[colors[constraint]]++;
+			a[slot] = m_a[constraint];
+			b[slot] = m_b[constraint];
+			distances[slot] = m_distances[constraint];
+		}
+		m_a.swap(a);
+		m_b.swap(b);
+		m_distances.swap(distances);
+	}
+
+	template class BasicConstraints<IndexType>;
+	template class BasicConstraints<CompactIndexType>;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+namespace ami
+{
+	// Undirected distance constraints, stored once per vertex pair as a canonical edge list (a < b)
+	// The edge list is grouped by color: constraints of the same color never share a vertex,
+	// so each color batch can be projected in parallel
+	// The per vertex neighbourhood is kept apart, as a read only compressed sparse row adjacency
+	// Index is the type the vertices are stored with: CompactIndexType halves the buffers a step streams
+	// through, for meshes of at most 65536 vertices. Offsets into the buffers are always IndexType
+	template <typename Index>
+	class BasicConstraints
+	{
+	public:
+		// neighbours of vertex v are [offsets[v], offsets[v + 1]) in neighbours
+		class Adjacency
+		{
+		public:
+			IndexType getVertexCount() const {
+				return m_offsets.empty() ? 0 : m_offsets.size() - 1;
+			}
+			IndexType begin(IndexType vertex) const {
+				return m_offsets[vertex];
+			}
+			IndexType end(IndexType vertex) const {
+				return m_offsets[vertex + 1];
+			}
+			IndexType getNeighbour(IndexType index) const {
+				return m_neighbours[index];
+			}
+
+			const std::vector<IndexType> & getOffsets() const {
+				return m_offsets;
+			}
+			const std::vector<Index> & getNeighbours() const {
+				return m_neighbours;
+			}
+
+		private:
+			friend class BasicConstraints;
+
+			std::vector<IndexType> m_offsets;
+			std::vector<Index> m_neighbours;
+		};
+
+		BasicConstraints() {}
+
+		// room for constraints more staged constraints
+		void reserve(IndexType constraints) {
+			m_staged.reserve(m_staged.size() + constraints);
+		}
+
+		// stage a constraint between a and b, it is only available after build()
+		// throws std::invalid_argument if a vertex does not fit in Index
+		void add(IndexType a, IndexType b, float distance);
+
+		// canonicalize the staged constraints into the edge list, color it and build the adjacency
+		void build(IndexType vertexCount);
+
+		IndexType size() const {
+			return m_a.size();
+		}
+		IndexType getA(IndexType constraint) const {
+			return m_a[constraint];
+		}
+		IndexType getB(IndexType constraint) const {
+			return m_b[constraint];
+		}
+		float getDistance(IndexType constraint) const {
+			return m_distances[constraint];
+		}
+
+		const std::vector<Index> & getAs() const {
+			return m_a;
+		}
+		const std::vector<Index> & getBs() const {
+			return m_b;
+		}
+		const std::vector<float> & getDistances() const {
+			return m_distances;
+		}
+
+		unsigned int getColorCount() const {
+			return m_colorOffsets.empty() ? 0 : m_colorOffsets.size() - 1;
+		}
+		IndexType getColorBegin(unsigned int color) const {
+			return m_colorOffsets[color];
+		}
+		IndexType getColorEnd(unsigned int color) const {
+			return m_colorOffsets[color + 1];
+		}
+
+		const Adjacency & getAdjacency() const {
+			return m_adjacency;
+		}
+
+	private:
+		struct Staged
+		{
+			Index a;
+			Index b;
+			float distance;
+		};
+
+		void buildAdjacency(IndexType vertexCount);
+		void buildColors(IndexType vertexCount);
+
+		std::vector<Staged> m_staged;
+
+		std::vector<Index> m_a;
+		std::vector<Index> m_b;
+		std::vector<float> m_distances;
+		std::vector<IndexType> m_colorOffsets;
+
+		Adjacency m_adjacency;
+	};
+
+	typedef BasicConstraints<IndexType> PatternConstraints;
+	typedef BasicConstraints<CompactIndexType> CompactConstraints;
+}
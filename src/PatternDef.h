@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Operation.h"
+#include "PatternRound.h"
 #include <vector>
 
 namespace ami
@@ -9,13 +10,14 @@ namespace ami
 	{
 	public:
 		// A pattern definition consists on a series of rounds
-		// Each round consists a series of operation types
-		typedef Operation::Operations Round;
+		// Each round consists a series of operation types, kept as runs
+		typedef PatternRound Round;
 
 		PatternDef()
 		{
 			// all PatternDefinitions contain a Loop to start with... then MR or other stitches
-			std::vector<Operation::Type> loop = { Operation::Type::LP };
+			Round loop;
+			loop.add(Operation::Type::LP);
 			this->addRound(loop);
 		}
 
@@ -27,7 +29,29 @@ namespace ami
 			return m_rounds;
 		}
 
-		void addRound(Operation::Operations & round)
+		// operations in all rounds, the starting loop included
+		std::size_t getStitchCount() const
+		{
+			std::size_t stitches = 0;
+			for (auto & round : m_rounds)
+			{
+				stitches += round.size();
+			}
+			return stitches;
+		}
+
+		// rounds both patterns share from the start, all of them if both are equal
+		unsigned int getSharedRounds(const PatternDef & other) const
+		{
+			unsigned int shared = 0;
+			while (shared < m_rounds.size() && shared < other.m_rounds.size() && m_rounds[shared] == other.m_rounds[shared])
+			{
+				shared++;
+			}
+			return shared;
+		}
+
+		void addRound(const Round & round)
 		{
 			m_rounds.push_back(round);
 		}
@@ -42,20 +66,19 @@ namespace ami
 
 				unsigned int previousRoundStitches = previousRound->size();
 
-				// compute the needed previous stitches for the round
+				// compute the needed previous stitches for the round, a run at a time
 				bool bFirstStitch = true;
 				unsigned int neededStitches = 0;
-				for (Operation::Type type : *round)
+				round->forEachRun([&](const Operation::Run & run)
 				{
-					unsigned int opStitches = Operation::getRequiredStitches(type);
+					unsigned int opStitches = Operation::getRequiredStitches(run.type);
+					neededStitches += opStitches * run.count;
 					if (bFirstStitch && opStitches == 0)
 					{
-						opStitches = 1;
+						neededStitches += 1;
 					}
-
-					neededStitches += opStitches;
 					bFirstStitch = false;
-				}
+				});
 
 				if (previousRoundStitches != neededStitches)
 				{
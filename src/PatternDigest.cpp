@@ -1,67 +1,282 @@
 #include "PatternDigest.h"
+#include "Log.h"
+#include "PatternBinary.h"
+#include "XmlReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
 
 namespace ami
 {
-	vector<PatternDef> PatternDigest::digest(const string & file)
+	namespace
 	{
-		const static string tagPattern = "Pattern";
-		const static string tagRound = "Round";
-		const static string tagOperation = "Operation";
-		const static string attCount = "Count";
+		// Pattern > Round > Operation, or Pattern > Round > Repeat > Operation for repeated groups
+		// anything else is ignored
+		class DigestHandler : public XmlReader::Handler
+		{
+		public:
+			DigestHandler(std::vector<PatternDef> & patterns)
+				:
+				m_patterns(patterns),
+				m_roundIndex(0),
+				m_count(0),
+				m_repeat(0)
+			{}
 
-		vector<PatternDef> patterns;
+			void startElement(const std::string & name, const XmlReader::Attributes & attributes) override
+			{
+				const static std::string tagPattern = "Pattern";
+				const static std::string tagRound = "Round";
+				const static std::string tagRepeat = "Repeat";
+				const static std::string tagOperation = "Operation";
+				const static std::string attCount = "Count";
+				const static std::string noCount = "0";
+				const static std::string noRepeat = "1";
 
-		if (ofFile::doesFileExist(file))
-		{
-			ofxXmlSettings data;
+				Element parent = m_elements.empty() ? NONE : m_elements.back();
+				Element element = OTHER;
+				if (parent == NONE && name == tagPattern)
+				{
+					m_patterns.push_back(PatternDef());
+					m_roundIndex = 0;
+					element = PATTERN;
+				}
+				else if (parent == PATTERN && name == tagRound)
+				{
+					m_round = PatternDef::Round();
+					element = ROUND;
+				}
+				else if (parent == ROUND && name == tagRepeat)
+				{
+					m_runs.clear();
+					m_repeat = std::strtoul(XmlReader::getAttribute(attributes, attCount, noRepeat).c_str(), nullptr, 10);
+					element = REPEAT;
+				}
+				else if ((parent == ROUND || parent == REPEAT) && name == tagOperation)
+				{
+					m_operation.clear();
+					m_count = std::strtoul(XmlReader::getAttribute(attributes, attCount, noCount).c_str(), nullptr, 10);
+					element = OPERATION;
+				}
+				m_elements.push_back(element);
+			}
 
-			data.load(file);
+			void endElement(const std::string &) override
+			{
+				Element element = m_elements.back();
+				m_elements.pop_back();
 
-			// for each pattern
-			for (unsigned int patternIndex = 0; patternIndex < data.getNumTags(tagPattern); patternIndex++)
+				if (element == OPERATION)
+				{
+					addOperation(m_elements.back() == REPEAT);
+				}
+				else if (element == REPEAT)
+				{
+					m_round.addGroup(m_runs, m_repeat);
+				}
+				else if (element == ROUND)
+				{
+					m_patterns.back().addRound(m_round);
+					m_roundIndex++;
+				}
+			}
+
+			void characters(const char * text, std::size_t length) override
 			{
-				PatternDef def;
+				if (!m_elements.empty() && m_elements.back() == OPERATION)
+				{
+					m_operation.append(text, length);
+				}
+			}
+
+		private:
+			enum Element {
+				NONE,
+				PATTERN,
+				ROUND,
+				REPEAT,
+				OPERATION,
+				OTHER
+			};
 
-				data.pushTag(tagPattern, patternIndex);
-				// for each row in the pattern
-				for (unsigned int roundIndex = 0; roundIndex < data.getNumTags(tagRound); roundIndex++)
+			void addOperation(bool bRepeat)
+			{
+				try
 				{
-					data.pushTag(tagRound, roundIndex);
+					std::string operation = trim(m_operation);
+					if (operation == "") throw std::invalid_argument("Empty operation");
 
-					Operation::Operations op;
-					// for each operation in the row
-					for (unsigned int operationIndex = 0; operationIndex < data.getNumTags(tagOperation); operationIndex++)
+					// get operation as type
+					Operation::Type type = Operation::getOperation(operation);
+					// parse for special operations (MR and others), kept as a run
+					Operation::Run run = Operation::parseOperation(type, m_count);
+					if (bRepeat)
+					{
+						m_runs.push_back(run);
+					}
+					else
 					{
-						string operation = data.getValue(tagOperation, string(""), operationIndex);
-						unsigned int count = data.getAttribute(tagOperation, attCount, 0, operationIndex);
-						if (operation != "")
-						{
-							// get operation as type
-							Operation::Type type = Operation::getOperation(operation);
-							// parse for special operations (MR and others)
-							vector<Operation::Type> operations = Operation::parseOperation(type, count);
-							op.insert(op.end(), operations.begin(), operations.end());
-						}
-						else
-						{
-							ofLogVerbose("PatternDigest") << "Invalid operation: Round{" << roundIndex << "} Pattern {" << patternIndex;
-						}
+						m_round.add(run);
 					}
+				}
+				catch (std::invalid_argument & e)
+				{
+					LogVerbose("PatternDigest") << "Invalid operation: Round{" << m_roundIndex << "} Pattern {" << m_patterns.size() - 1 << "}: " << e.what();
+				}
+			}
 
-					def.addRound(op);
+			static std::string trim(const std::string & text)
+			{
+				std::size_t begin = 0;
+				std::size_t end = text.size();
+				while (begin < end && std::isspace((unsigned char)text[begin])) begin++;
+				while (end > begin && std::isspace((unsigned char)text[end - 1])) end--;
+				return text.substr(begin, end - begin);
+			}
 
-					data.popTag();
-				}
+			std::vector<PatternDef> & m_patterns;
+
+			// open elements, only as deep as the file nests
+			std::vector<Element> m_elements;
+
+			unsigned int m_roundIndex;
+			PatternDef::Round m_round;
+			std::string m_operation;
+			unsigned int m_count;
+
+			// runs of the open Repeat
+			std::vector<Operation::Run> m_runs;
+			unsigned int m_repeat;
+		};
+	}
+
+	std::vector<PatternDef> PatternDigest::digest(const std::string & file)
+	{
+		std::string error;
+		std::vector<PatternDef> patterns = digest(file, error);
+		if (!error.empty())
+		{
+			LogError("PatternDigest") << error;
+		}
+		return patterns;
+	}
 
-				patterns.push_back(def);
-				data.popTag();
+	std::vector<PatternDef> PatternDigest::digest(const std::string & file, std::string & error)
+	{
+		std::vector<PatternDef> patterns;
+		error.clear();
+
+		// binary patterns are mapped instead of parsed, whatever their extension
+		if (PatternBinary::isBinary(file))
+		{
+			PatternBinary binary;
+			if (!binary.open(file))
+			{
+				error = binary.getError();
+				return patterns;
+			}
+
+			try
+			{
+				patterns = binary.getPatterns();
+			}
+			catch (std::invalid_argument & e)
+			{
+				error = file + ": " + e.what();
+				patterns.clear();
 			}
+			return patterns;
+		}
+
+		std::ifstream in(file, std::ios::binary);
+		if (!in)
+		{
+			error = "File " + file + " not found";
+			return patterns;
 		}
-		else
+
+		return digest(in, file, error);
+	}
+
+	std::vector<PatternDef> PatternDigest::digest(std::istream & in, const std::string & name)
+	{
+		std::string error;
+		std::vector<PatternDef> patterns = digest(in, name, error);
+		if (!error.empty())
+		{
+			LogError("PatternDigest") << error;
+		}
+		return patterns;
+	}
+
+	std::vector<PatternDef> PatternDigest::digest(std::istream & in, const std::string & name, std::string & error)
+	{
+		std::vector<PatternDef> patterns;
+		error.clear();
+
+		// single pass over the input, rounds are built as their operations stream in
+		DigestHandler handler(patterns);
+		XmlReader reader;
+		if (!reader.parse(in, handler))
 		{
-			ofLogVerbose("PatternData") << "File " << file << " not found";
+			error = name + " is not valid xml: " + reader.getError();
+			patterns.clear();
 		}
 
 		return patterns;
 	}
-}
\ No newline at end of file
+
+	bool PatternDigest::save(const std::vector<PatternDef> & patterns, const std::string & file)
+	{
+		std::ofstream out(file);
+		if (!out)
+		{
+			LogError("PatternDigest") << "Could not write " << file;
+			return false;
+		}
+
+		save(patterns, out);
+		return bool(out);
+	}
+
+	void PatternDigest::save(const std::vector<PatternDef> & patterns, std::ostream & out)
+	{
+		for (auto & pattern : patterns)
+		{
+			out << "<Pattern>\n";
+			// the first round is the loop every PatternDef starts with, it is not written
+			for (std::size_t roundIndex = 1; roundIndex < pattern.getRounds().size(); roundIndex++)
+			{
+				const PatternDef::Round & round = pattern.getRounds()[roundIndex];
+
+				out << "\t<Round>\n";
+				// a first round of increases only reads better as the magic ring it parses back to
+				bool bRing = roundIndex == 1 && round.getRuns().size() == 1 && round.getGroups()[0].repeat == 1 &&
+					round.getRuns()[0].type == Operation::Type::INC;
+				for (auto & group : round.getGroups())
+				{
+					std::string indent = "\t\t";
+					if (group.repeat != 1)
+					{
+						out << indent << "<Repeat Count=\"" << group.repeat << "\">\n";
+						indent += "\t";
+					}
+					for (unsigned int run = group.begin; run < group.end; run++)
+					{
+						const Operation::Run & operation = round.getRuns()[run];
+						out << indent << "<Operation Count=\"" << operation.count << "\">" << Operation::getString(bRing ? Operation::Type::MR : operation.type) << "</Operation>\n";
+					}
+					if (group.repeat != 1)
+					{
+						out << "\t\t</Repeat>\n";
+					}
+				}
+				out << "\t</Round>\n";
+			}
+			out << "</Pattern>\n";
+		}
+	}
+}
@@ -1,7 +1,10 @@
 #pragma once
 
-#include "ofUtils.h"
-#include "ofxXmlSettings.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
 #include "PatternDef.h"
 
 namespace ami
@@ -9,7 +12,20 @@ namespace ami
 	class PatternDigest
 	{
 	public:
-		static vector<PatternDef> digest(const string & file);
+		// reads every <Pattern> of an xml file, or every pattern of a binary .amib file (see PatternBinary)
+		// paths are used as given (the app resolves them with ofToDataPath)
+		static std::vector<PatternDef> digest(const std::string & file);
+
+		// same as digest(file), but a failure is returned in error instead of logged (error is empty on success)
+		static std::vector<PatternDef> digest(const std::string & file, std::string & error);
+
+		// reads every <Pattern> of xml from a stream, name is only used in errors
+		static std::vector<PatternDef> digest(std::istream & in, const std::string & name);
+		static std::vector<PatternDef> digest(std::istream & in, const std::string & name, std::string & error);
+
+		// writes patterns in the format digest reads, runs of the same operation as one Count and groups as Repeat
+		static bool save(const std::vector<PatternDef> & patterns, const std::string & file);
+		static void save(const std::vector<PatternDef> & patterns, std::ostream & out);
 	};
 
-}
\ No newline at end of file
+}
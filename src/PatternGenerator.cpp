@@ -0,0 +1,118 @@
+#include "PatternGenerator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ami
+{
+	namespace
+	{
+		enum RoundKind {
+			RING,
+			INCREASE,
+			PLAIN,
+			DECREASE,
+			FINISH
+		};
+
+		// rounds of the shape as (kind, sides, r) without building them, shared by generate and getStitchCount
+		template <class Visitor>
+		void visitRounds(const PatternGenerator::Settings & settings, Visitor visit)
+		{
+			const unsigned int sides = std::max(settings.sides, 1u);
+			const unsigned int rounds = std::max(settings.rounds, 1u);
+
+			visit(RING, sides, 1u);
+			for (unsigned int r = 2; r <= rounds; r++)
+			{
+				visit(INCREASE, sides, r);
+				if (settings.shape == PatternGenerator::CONE)
+				{
+					for (unsigned int h = 0; h < settings.height; h++) visit(PLAIN, sides, r);
+				}
+			}
+
+			unsigned int plainRounds = 0;
+			if (settings.shape == PatternGenerator::SPHERE) plainRounds = rounds;
+			if (settings.shape == PatternGenerator::CYLINDER) plainRounds = settings.height;
+			for (unsigned int h = 0; h < plainRounds; h++) visit(PLAIN, sides, rounds);
+
+			if (settings.bClosed)
+			{
+				for (unsigned int r = rounds; r >= 3; r--) visit(DECREASE, sides, r);
+				visit(FINISH, sides, 0u);
+			}
+		}
+	}
+
+	PatternDef PatternGenerator::generate(const Settings & settings)
+	{
+		PatternDef def;
+
+		visitRounds(settings, [&def](RoundKind kind, unsigned int sides, unsigned int r)
+		{
+			// rounds stay run length encoded: a few runs each, whatever the size
+			PatternDef::Round round;
+			switch (kind)
+			{
+				// sides x INC
+				case RING: round.add(Operation::parseOperation(Operation::Type::MR, sides)); break;
+				// sides x [SC x (r - 1), INC]: grows a round of sides * (r - 1) stitches to sides * r
+				case INCREASE: round.addGroup({ Operation::Run(Operation::Type::SC, r - 1), Operation::Run(Operation::Type::INC, 1) }, sides); break;
+				case PLAIN: round.add(Operation::Type::SC, sides * r); break;
+				// sides x [SC x (r - 2), DEC]: shrinks a round of sides * r stitches to sides * (r - 1)
+				case DECREASE: round.addGroup({ Operation::Run(Operation::Type::SC, r - 2), Operation::Run(Operation::Type::DEC, 1) }, sides); break;
+				default: round.add(Operation::Type::FO); break;
+			}
+			def.addRound(round);
+		});
+
+		return def;
+	}
+
+	std::size_t PatternGenerator::getStitchCount(const Settings & settings)
+	{
+		std::size_t stitches = 1; // the loop every pattern starts with
+
+		visitRounds(settings, [&stitches](RoundKind kind, unsigned int sides, unsigned int r)
+		{
+			switch (kind)
+			{
+				case RING: stitches += sides; break;
+				case DECREASE: stitches += sides * (r - 1); break;
+				case FINISH: stitches += 1; break;
+				default: stitches += sides * r; break;
+			}
+		});
+
+		return stitches;
+	}
+
+	PatternGenerator::Settings PatternGenerator::withStitches(Settings settings, std::size_t stitches)
+	{
+		settings.rounds = 1;
+		while (getStitchCount(settings) < stitches)
+		{
+			settings.rounds++;
+		}
+		return settings;
+	}
+
+	PatternGenerator::Shape PatternGenerator::getShape(const std::string & shape)
+	{
+		if (shape == "sphere") return SPHERE;
+		if (shape == "cylinder") return CYLINDER;
+		if (shape == "cone") return CONE;
+		throw std::invalid_argument("Shape " + shape + " not supported");
+	}
+
+	std::string PatternGenerator::getString(Shape shape)
+	{
+		switch (shape)
+		{
+			case SPHERE: return "sphere";
+			case CYLINDER: return "cylinder";
+			default: return "cone";
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "PatternDef.h"
+
+namespace ami
+{
+	// Builds valid patterns of parameterized shape and size, for scale testing
+	// Every shape starts with a magic ring of sides stitches and grows by increase rounds of
+	// sides x [SC x (r - 1), INC], closed shapes end with sides x [SC x (r - 2), DEC] rounds and a finish off
+	class PatternGenerator
+	{
+	public:
+		enum Shape {
+			SPHERE,
+			CYLINDER,
+			CONE
+		};
+
+		struct Settings
+		{
+			Shape shape = SPHERE;
+			unsigned int rounds = 10; // increase rounds, including the magic ring
+			unsigned int height = 10; // cylinder: plain rounds, cone: plain rounds after each increase round, sphere: unused (rounds)
+			unsigned int sides = 6; // magic ring stitches, and increases per round
+			bool bClosed = true; // decrease and finish off the end, otherwise the last round stays open
+		};
+
+		static PatternDef generate(const Settings & settings);
+
+		// operations generate(settings) would produce, without building the pattern
+		static std::size_t getStitchCount(const Settings & settings);
+
+		// smallest settings.rounds whose pattern has at least stitches operations
+		static Settings withStitches(Settings settings, std::size_t stitches);
+
+		static Shape getShape(const std::string & shape);
+		static std::string getString(Shape shape);
+	};
+}
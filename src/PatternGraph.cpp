@@ -1,45 +1,511 @@
 #include "PatternGraph.h"
-#include "ofUtils.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
 
 using namespace ami;
 
-PatternGraph::PatternGraph(const PatternDef & pattern)
+namespace
 {
-	unsigned int roundIndex = 0;
-	for (auto & round : pattern.getRounds())
+	// where a round starts in the graph, found before building it
+	struct RoundStart
 	{
-		unsigned int operationIndex = 0;
-		for (auto & op : round)
+		IndexType node = 0; // first node of the round
+		IndexType under = 0; // under of the node before it
+		IndexType edges = 0; // edges and faces before the round, once counted
+		IndexType faces = 0;
+	};
+
+	std::string getTooManyNodesError(std::uint64_t maxNodes)
+	{
+		return "More than " + std::to_string(maxNodes) + " nodes for the index type of the graph";
+	}
+
+	std::string getOperationError(unsigned int roundIndex, unsigned int operationIndex, const std::string & what)
+	{
+		std::stringstream ss;
+		ss << "Round " << roundIndex << ", Operation " << operationIndex << " failed: " << what;
+		return ss.str();
+	}
+
+	// node ids follow from the stitches of the rounds before, and the under of a node from the under of the node before it:
+	// SC takes the next one, INC the same one and DEC the one after the next, so one pass over the runs finds
+	// where every round starts without going through its nodes. The last entry holds the node count
+	// throws std::invalid_argument where addOperation would
+	std::vector<RoundStart> findRoundStarts(const PatternDef & pattern)
+	{
+		std::vector<RoundStart> starts(pattern.getRounds().size() + 1);
+		IndexType node = 0; // nodes added so far
+		IndexType under = 0; // under of the last of them
+		for (unsigned int roundIndex = 0; roundIndex < pattern.getRounds().size(); roundIndex++)
+		{
+			starts[roundIndex].node = node;
+			starts[roundIndex].under = under;
+
+			unsigned int operationIndex = 0;
+			pattern.getRounds()[roundIndex].forEachRun([&](const Operation::Run & run)
+			{
+				if (run.count == 0) return;
+				if (node == 0 && run.type != Operation::Type::LP)
+				{
+					throw std::invalid_argument(getOperationError(roundIndex, operationIndex, "A pattern starts with a loop"));
+				}
+
+				switch (run.type)
+				{
+					case Operation::Type::LP:
+					{
+						node += run.count;
+						under = node - 1; // a loop is its own under
+						break;
+					}
+					case Operation::Type::SC:
+					{
+						node += run.count;
+						under += run.count;
+						break;
+					}
+					case Operation::Type::INC:
+					{
+						node += run.count;
+						break;
+					}
+					case Operation::Type::DEC:
+					{
+						// every DEC brings its under one closer to itself, once the node before is its own under
+						// the next of its next is the DEC itself, whose next is not set yet: 0
+						for (IndexType left = run.count; left > 0;)
+						{
+							if (under + 1 == node)
+							{
+								under = 0;
+								node++;
+								left--;
+							}
+							else
+							{
+								IndexType steps = std::min(left, node - 1 - under);
+								under += 2 * steps;
+								node += steps;
+								left -= steps;
+							}
+						}
+						break;
+					}
+					case Operation::Type::FO:
+					{
+						break;
+					}
+					default:
+					{
+						throw std::invalid_argument(getOperationError(roundIndex, operationIndex, "Operation not supported"));
+					}
+				}
+				operationIndex += run.count;
+			});
+		}
+		starts.back().node = node;
+		starts.back().under = under;
+		return starts;
+	}
+
+	// the nodes of one round, as addOperation leaves them, except the next of the last node of the graph
+	template <typename Index>
+	void addRoundNodes(const PatternDef::Round & round, const RoundStart & start, typename BasicPatternGraph<Index>::Nodes & nodes)
+	{
+		IndexType id = start.node;
+		IndexType under = start.under;
+		round.forEachRun([&](const Operation::Run & run)
+		{
+			if (run.type == Operation::Type::FO) return;
+
+			for (unsigned int i = 0; i < run.count; i++)
+			{
+				IndexType last = id - 1;
+				switch (run.type)
+				{
+					case Operation::Type::LP: last = id; under = id; break;
+					case Operation::Type::SC: under = under + 1; break;
+					case Operation::Type::DEC: under = under + 1 == id ? 0 : under + 2; break;
+					default: break; // INC keeps the under of the node before
+				}
+				nodes.last[id] = last;
+				nodes.under[id] = under;
+				nodes.next[id] = id + 1;
+				nodes.op[id] = run.type;
+				id++;
+			}
+		});
+	}
+
+	// the edges and faces addOperation adds for one round, read from the nodes of the whole graph
+	// with null edges and faces they are only counted
+	template <typename Index>
+	class RoundLinks
+	{
+	public:
+		typedef typename BasicPatternGraph<Index>::Nodes Nodes;
+		typedef typename BasicPatternGraph<Index>::Edge Edge;
+		typedef typename BasicPatternGraph<Index>::Face Face;
+
+		RoundLinks(const Nodes & nodes, Edge * edges, Face * faces)
+			:
+			m_nodes(nodes),
+			m_edges(edges),
+			m_faces(faces)
+		{}
+
+		void add(const PatternDef::Round & round, IndexType firstNode)
+		{
+			IndexType id = firstNode;
+			round.forEachRun([&](const Operation::Run & run)
+			{
+				for (unsigned int i = 0; i < run.count; i++)
+				{
+					if (run.type == Operation::Type::FO)
+					{
+						this->addFinishOff(id);
+						continue;
+					}
+					if (run.type != Operation::Type::LP)
+					{
+						this->addStitch(run.type, id);
+					}
+					id++;
+				}
+			});
+		}
+
+		IndexType getEdgeCount() const {
+			return m_edgeCount;
+		}
+		IndexType getFaceCount() const {
+			return m_faceCount;
+		}
+
+	private:
+		// next of node when the graph only had its first nodeCount nodes: the last of them had none yet
+		IndexType getNext(IndexType node, IndexType nodeCount) const
+		{
+			if (node + 1 < nodeCount) return node + 1;
+			return m_nodes.op[node] == Operation::Type::LP ? node : 0;
+		}
+
+		void addFinishOff(IndexType nodeCount)
+		{
+			IndexType nextClose = getNext(m_nodes.under[nodeCount - 1], nodeCount);
+			IndexType lastClose = nodeCount - 1;
+			while (nextClose < lastClose)
+			{
+				this->addEdge(nextClose, lastClose, 0.f);
+
+				nextClose = getNext(nextClose, nodeCount);
+				lastClose = m_nodes.last[lastClose];
+			}
+		}
+
+		void addStitch(Operation::Type type, IndexType id)
 		{
-			try
+			IndexType last = id - 1;
+			IndexType under = m_nodes.under[id];
+			IndexType lastUnder = m_nodes.under[last];
+
+			switch (type)
 			{
-				addOperation(op);
+				case Operation::Type::SC:
+				{
+					this->addEdge(id, last, 1.f);
+					this->addEdge(id, under, 1.f);
+					this->addEdge(id, lastUnder, 1.f);
+
+					this->addFace(id, last, lastUnder);
+					this->addFace(id, lastUnder, under);
+					break;
+				}
+				case Operation::Type::INC:
+				{
+					this->addEdge(id, last, 1.f);
+					this->addEdge(id, under, 1.f);
+
+					this->addFace(id, last, lastUnder);
+					break;
+				}
+				case Operation::Type::DEC:
+				{
+					IndexType lastUnderNext = getNext(lastUnder, id + 1);
+					IndexType underLast = m_nodes.last[under];
+
+					this->addEdge(id, last, 1.f);
+					this->addEdge(id, lastUnder, 1.f);
+					this->addEdge(id, lastUnderNext, 1.f);
+					this->addEdge(id, under, 1.f);
+
+					this->addFace(id, last, lastUnder);
+					this->addFace(id, lastUnder, underLast);
+					this->addFace(id, underLast, under);
+					break;
+				}
+				default:
+				{
+					break;
+				}
 			}
-			catch (std::invalid_argument & e)
+		}
+
+		void addEdge(IndexType from, IndexType to, float distance)
+		{
+			if (m_edges)
+			{
+				Edge & edge = m_edges[m_edgeCount];
+				edge.from = from;
+				edge.to = to;
+				edge.distance = distance;
+			}
+			m_edgeCount++;
+		}
+
+		void addFace(IndexType a, IndexType b, IndexType c)
+		{
+			if (a == b || a == c || b == c) return; // same check as Graph::addFace
+			if (m_faces)
+			{
+				Face & face = m_faces[m_faceCount];
+				face.ids[0] = a;
+				face.ids[1] = b;
+				face.ids[2] = c;
+			}
+			m_faceCount++;
+		}
+
+		const Nodes & m_nodes;
+		Edge * m_edges;
+		Face * m_faces;
+		IndexType m_edgeCount = 0;
+		IndexType m_faceCount = 0;
+	};
+}
+
+template <typename Index>
+BasicPatternGraph<Index>::BasicPatternGraph(const PatternDef & pattern)
+{
+	reserve(PatternGraph::count(pattern));
+	addRounds(pattern, 0, pattern.getRounds().size());
+}
+
+template <typename Index>
+BasicPatternGraph<Index>::BasicPatternGraph(const PatternDef & pattern, ThreadPool & pool)
+{
+	const std::vector<PatternDef::Round> & rounds = pattern.getRounds();
+	std::vector<RoundStart> starts = findRoundStarts(pattern);
+	IndexType nodeCount = starts.back().node;
+	if (nodeCount > MaxNodes)
+	{
+		throw std::invalid_argument(getTooManyNodesError(MaxNodes));
+	}
+
+	// rounds range from a few stitches to thousands, threads steal a few at a time once done with theirs
+	// small graphs are built on the calling thread alone, waking the workers would take longer
+	const IndexType minNodes = 8192;
+	unsigned int grain = std::max<unsigned int>(1, rounds.size() / (pool.getThreadCount() * 8));
+	if (nodeCount < minNodes) grain = std::max<unsigned int>(1, rounds.size());
+
+	Nodes nodes;
+	nodes.last.resize(nodeCount);
+	nodes.under.resize(nodeCount);
+	nodes.next.resize(nodeCount);
+	nodes.op.resize(nodeCount);
+	pool.parallelForEach(0, rounds.size(), grain, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int round = begin; round < end; round++)
+		{
+			addRoundNodes<Index>(rounds[round], starts[round], nodes);
+		}
+	});
+	if (nodeCount > 0)
+	{
+		nodes.next.back() = nodes.op.back() == Operation::Type::LP ? nodeCount - 1 : 0;
+	}
+
+	// FO and degenerate faces make the edges and faces of a round depend on its nodes: count them, then add them
+	// at the offsets of the rounds before
+	pool.parallelForEach(0, rounds.size(), grain, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int round = begin; round < end; round++)
+		{
+			RoundLinks<Index> links(nodes, nullptr, nullptr);
+			links.add(rounds[round], starts[round].node);
+			starts[round].edges = links.getEdgeCount();
+			starts[round].faces = links.getFaceCount();
+		}
+	});
+	IndexType edgeCount = 0;
+	IndexType faceCount = 0;
+	for (RoundStart & start : starts)
+	{
+		std::swap(start.edges, edgeCount);
+		std::swap(start.faces, faceCount);
+		edgeCount += start.edges;
+		faceCount += start.faces;
+	}
+
+	std::vector<Edge> edges(edgeCount);
+	std::vector<Face> faces(faceCount);
+	pool.parallelForEach(0, rounds.size(), grain, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int round = begin; round < end; round++)
+		{
+			RoundLinks<Index> links(nodes, edges.data() + starts[round].edges, faces.data() + starts[round].faces);
+			links.add(rounds[round], starts[round].node);
+		}
+	});
+
+	m_roundEnds.resize(rounds.size());
+	for (unsigned int round = 0; round < rounds.size(); round++)
+	{
+		const RoundStart & next = starts[round + 1];
+		RoundEnd & end = m_roundEnds[round];
+		end.nodes = next.node;
+		end.edges = next.edges;
+		end.faces = next.faces;
+		end.lastNext = next.node > 0 && nodes.op[next.node - 1] == Operation::Type::LP ? next.node - 1 : 0;
+	}
+
+	m_graph = Graph(std::move(nodes), std::move(edges), std::move(faces));
+}
+
+PatternGraph::Size PatternGraph::count(const PatternDef & pattern, unsigned int firstRound)
+{
+	Size size;
+	// FO joins the nodes from the under of the last node to the last node, they span at most the last two rounds
+	IndexType roundNodes = 0;
+	IndexType lastRoundNodes = 0;
+	for (unsigned int roundIndex = 0; roundIndex < pattern.getRounds().size(); roundIndex++)
+	{
+		bool bCounted = roundIndex >= firstRound;
+		IndexType nodes = 0;
+		pattern.getRounds()[roundIndex].forEachRun([&](const Operation::Run & run)
+		{
+			Operation::Traits traits = Operation::getTraits(run.type);
+			nodes += traits.nodes * run.count;
+			if (!bCounted) return;
+
+			size.nodes += traits.nodes * run.count;
+			size.edges += traits.edges * run.count;
+			size.faces += traits.faces * run.count;
+			if (run.type == Operation::Type::FO)
 			{
-				std::stringstream ss;
-				ss << "Round " << ofToString(roundIndex) << ", Operation " << ofToString(operationIndex) << " failed: " << e.what();
-				throw std::invalid_argument(ss.str());
+				size.edges += run.count * ((roundNodes + lastRoundNodes + nodes) / 2 + 1);
 			}
+		});
 
-			operationIndex++;
+		if (nodes > 0)
+		{
+			lastRoundNodes = roundNodes;
+			roundNodes = nodes;
 		}
-		roundIndex++;
+		if (bCounted) size.rounds++;
+	}
+	return size;
+}
+
+template <typename Index>
+void BasicPatternGraph<Index>::reserve(const Size & size)
+{
+	const Nodes & nodes = m_graph.getNodes();
+	m_graph.reserve(nodes.size() + size.nodes, m_graph.getEdges().size() + size.edges, m_graph.getFaces().size() + size.faces);
+	m_roundEnds.reserve(m_roundEnds.size() + size.rounds);
+}
+
+template <typename Index>
+IndexType BasicPatternGraph<Index>::rebuild(const PatternDef & pattern, unsigned int firstRound)
+{
+	firstRound = std::min<unsigned int>(firstRound, m_roundEnds.size());
+	IndexType keptNodes = truncate(firstRound);
+
+	reserve(PatternGraph::count(pattern, firstRound));
+	addRounds(pattern, firstRound, pattern.getRounds().size());
+	return keptNodes;
+}
+
+template <typename Index>
+IndexType BasicPatternGraph<Index>::truncate(unsigned int rounds)
+{
+	if (rounds == 0)
+	{
+		m_graph = Graph();
+		m_roundEnds.clear();
+	}
+	else if (rounds < m_roundEnds.size())
+	{
+		const RoundEnd & end = m_roundEnds[rounds - 1];
+		m_graph.truncate(end.nodes, end.edges, end.faces, end.lastNext);
+		m_roundEnds.resize(rounds);
+	}
+	return m_graph.getNodes().size();
+}
+
+template <typename Index>
+void BasicPatternGraph<Index>::addRounds(const PatternDef & pattern, unsigned int firstRound, unsigned int lastRound)
+{
+	if (firstRound != m_roundEnds.size())
+	{
+		throw std::invalid_argument("Rounds must be added in order, round " + std::to_string(firstRound) + " follows " + std::to_string(m_roundEnds.size()) + " rounds");
+	}
+
+	lastRound = std::min<unsigned int>(lastRound, pattern.getRounds().size());
+	for (unsigned int roundIndex = firstRound; roundIndex < lastRound; roundIndex++)
+	{
+		const PatternDef::Round & round = pattern.getRounds()[roundIndex];
+
+		// runs are consumed as they are, the round is never expanded
+		unsigned int operationIndex = 0;
+		round.forEachRun([&](const Operation::Run & run)
+		{
+			for (unsigned int i = 0; i < run.count; i++)
+			{
+				try
+				{
+					addOperation(run.type);
+				}
+				catch (std::invalid_argument & e)
+				{
+					throw std::invalid_argument(getOperationError(roundIndex, operationIndex, e.what()));
+				}
+
+				operationIndex++;
+			}
+		});
+
+		RoundEnd end;
+		end.nodes = m_graph.getNodes().size();
+		end.edges = m_graph.getEdges().size();
+		end.faces = m_graph.getFaces().size();
+		end.lastNext = m_graph.getNodes().empty() ? 0 : m_graph.getNodes().next.back();
+		m_roundEnds.push_back(end);
 	}
 }
 
-void PatternGraph::addOperation(Operation::Type type)
+template <typename Index>
+void BasicPatternGraph<Index>::addOperation(Operation::Type type)
 {
 	// Update next as necessary
 
+	IndexType id = m_graph.getNodes().size();
+	if (id == 0 && type != Operation::Type::LP)
+	{
+		throw std::invalid_argument("A pattern starts with a loop");
+	}
+
 	// Operations that do NOT add nodes
 	switch (type)
 	{
 		case Operation::Type::FO:
 		{
 			// this operation does not add a new vertex
-			Graph::NodeIterator nextClose = m_graph.back().under().next();
-			Graph::NodeIterator lastClose = m_graph.back();
+			typename Graph::NodeIterator nextClose = m_graph.back().under().next();
+			typename Graph::NodeIterator lastClose = m_graph.back();
 			while (nextClose < lastClose) // until last and next meets. Careful!
 			{
 				// add constraint
@@ -50,57 +516,62 @@ void PatternGraph::addOperation(Operation::Type type)
 			}
 			return;
 		}
+		default:
+			break;
 	}
 
 	// Operations that add nodes, add node first
 
-	Graph::NodeIterator node_it = m_graph.addNode();
-	Node & node = node_it.node();
+	if (id >= MaxNodes)
+	{
+		throw std::invalid_argument(getTooManyNodesError(MaxNodes));
+	}
 
-	node.data.op = type;
-	node.next = 0; // there is no next yet!
-	node.last = 0; // default
-	if (node.id > 0)
+	if (id > 0)
 	{
-		node.last = node.id - 1;
-		node_it.last().node().next = node.id; // asign ourselves as our last's next
+		m_graph.setNext(id - 1, id); // asign ourselves as our last's next
 	}
 
-	switch (type)
+	if (type == Operation::Type::LP)
 	{
-		case Operation::Type::LP:
-		{
-			// loop only adds the base stitch
-			node.under = node.id;
-			node.last = node.id;
-			node.next = node.id;
-			break;
-		}
+		// loop only adds the base stitch
+		m_graph.addNode(type, id, id, id);
+		return;
+	}
+
+	// there is no next yet! under is set once the node is there, it may be the node itself
+	IndexType last = id - 1;
+	typename Graph::NodeIterator node_it = m_graph.addNode(type, last, id, 0);
+	IndexType lastUnder = node_it.last().under().id;
 
+	switch (type)
+	{
 		case Operation::Type::SC:
 		{
 			// TODO: check if we have enough stitches
 
-			node.under = node_it.last().under().next().id;
+			IndexType under = node_it.last().under().next().id;
+			m_graph.setUnder(id, under);
 
-			m_graph.addEdge(node.id, node.last, 1.f);
-			m_graph.addEdge(node.id, node.under, 1.f);
-			m_graph.addEdge(node.id, node_it.last().under().id, 1.f);
+			m_graph.addEdge(id, last, 1.f);
+			m_graph.addEdge(id, under, 1.f);
+			m_graph.addEdge(id, lastUnder, 1.f);
 
-			m_graph.addFace(node.id, node.last, node_it.last().under().id);
-			m_graph.addFace(node.id, node_it.last().under().id, node.under);
+			m_graph.addFace(id, last, lastUnder);
+			m_graph.addFace(id, lastUnder, under);
 
 			break;
 		}
 		case Operation::Type::INC:
 		{
 			// same under as last stitch
-			node.under = node_it.last().under().id;
+			IndexType under = lastUnder;
+			m_graph.setUnder(id, under);
 
-			m_graph.addEdge(node.id, node.last, 1.f);
-			m_graph.addEdge(node.id, node.under, 1.f);
+			m_graph.addEdge(id, last, 1.f);
+			m_graph.addEdge(id, under, 1.f);
 
-			m_graph.addFace(node.id, node.last, node_it.last().under().id);
+			m_graph.addFace(id, last, lastUnder);
 
 			break;
 		}
@@ -109,25 +580,96 @@ void PatternGraph::addOperation(Operation::Type type)
 			// TODO: check if we have enough stitches
 
 			// under is next next stitch, we are connecting 2
-			node.under = node_it.last().under().next().next().id;
-
+			IndexType under = node_it.last().under().next().next().id;
+			m_graph.setUnder(id, under);
+			IndexType lastUnderNext = node_it.last().under().next().id;
+			IndexType underLast = node_it.under().last().id;
 
-			m_graph.addEdge(node.id, node.last, 1.f);
-			m_graph.addEdge(node.id, node_it.last().under().id, 1.f);
-			m_graph.addEdge(node.id, node_it.last().under().next().id, 1.f);
-			m_graph.addEdge(node.id, node.under, 1.f);
+			m_graph.addEdge(id, last, 1.f);
+			m_graph.addEdge(id, lastUnder, 1.f);
+			m_graph.addEdge(id, lastUnderNext, 1.f);
+			m_graph.addEdge(id, under, 1.f);
 
-			m_graph.addFace(node.id, node.last, node_it.last().under().id);
-			m_graph.addFace(node.id, node_it.last().under().id, node_it.under().last().id);
-			m_graph.addFace(node.id, node_it.under().last().id, node.under);
+			m_graph.addFace(id, last, lastUnder);
+			m_graph.addFace(id, lastUnder, underLast);
+			m_graph.addFace(id, underLast, under);
 
 			break;
 		}
 
 		default:
 		{
-			ofLogVerbose("PatternMesh") << "Operation not supported";
+			LogVerbose("PatternMesh") << "Operation not supported";
 			throw std::invalid_argument("Operation not supported");
 		}
 	}
 }
+
+template class ami::BasicPatternGraph<IndexType>;
+template class ami::BasicPatternGraph<CompactIndexType>;
+
+PatternGraph::PatternGraph(const Size & size)
+	:
+	m_bCompact(fitsCompact(size.nodes))
+{
+	this->withGraph([&](auto & graph) { graph.reserve(size); });
+}
+
+PatternGraph::PatternGraph(const PatternDef & pattern)
+	:
+	m_bCompact(fitsCompact(count(pattern).nodes))
+{
+	if (m_bCompact) m_compactGraph = CompactGraph(pattern);
+	else m_graph = WideGraph(pattern);
+}
+
+PatternGraph::PatternGraph(const PatternDef & pattern, ThreadPool & pool)
+	:
+	m_bCompact(fitsCompact(count(pattern).nodes))
+{
+	if (m_bCompact) m_compactGraph = CompactGraph(pattern, pool);
+	else m_graph = WideGraph(pattern, pool);
+}
+
+PatternGraph::PatternGraph(WideGraph graph)
+	:
+	m_bCompact(false),
+	m_graph(std::move(graph))
+{}
+
+PatternGraph::PatternGraph(CompactGraph graph)
+	:
+	m_bCompact(true),
+	m_compactGraph(std::move(graph))
+{}
+
+IndexType PatternGraph::rebuild(const PatternDef & pattern, unsigned int firstRound)
+{
+	bool bCompact = fitsCompact(count(pattern).nodes);
+	if (bCompact != m_bCompact)
+	{
+		// the rounds kept are converted to the new width, before adding the ones that make it change
+		if (bCompact)
+		{
+			m_graph.truncate(firstRound);
+			m_compactGraph = CompactGraph(m_graph);
+			m_graph = WideGraph();
+		}
+		else
+		{
+			m_compactGraph.truncate(firstRound);
+			m_graph = WideGraph(m_compactGraph);
+			m_compactGraph = CompactGraph();
+		}
+		m_bCompact = bCompact;
+	}
+
+	IndexType keptNodes = 0;
+	this->withGraph([&](auto & graph) { keptNodes = graph.rebuild(pattern, firstRound); });
+	return keptNodes;
+}
+
+void PatternGraph::addRounds(const PatternDef & pattern, unsigned int firstRound, unsigned int lastRound)
+{
+	this->withGraph([&](auto & graph) { graph.addRounds(pattern, firstRound, lastRound); });
+}
@@ -1,41 +1,82 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <list>
-#include "ofMath.h"
+#include <utility>
+#include "Types.h"
 #include "PatternDef.h"
+#include "ThreadPool.h"
 
 namespace ami
 {
-	class PatternGraph
+	// bounds checking of graph node access, std::vector::at in debug builds and plain indexing in release
+	struct CheckedAccess
 	{
-	public:
-		struct Data
-		{
-			Operation::Type op;
-		};
+		template <typename T>
+		static T & at(std::vector<T> & values, IndexType index) {
+			return values.at(index);
+		}
+	};
+
+	struct UncheckedAccess
+	{
+		template <typename T>
+		static T & at(std::vector<T> & values, IndexType index) {
+			return values[index];
+		}
+	};
+
+	// msvc defines _DEBUG with the debug runtime, other compilers leave NDEBUG unset
+#if defined(_DEBUG) || (!defined(_MSC_VER) && !defined(NDEBUG))
+	typedef CheckedAccess NodeAccess;
+#else
+	typedef UncheckedAccess NodeAccess;
+#endif
 
+	// buffer sizes of a graph, see PatternGraph::count()
+	struct GraphSize
+	{
+		IndexType nodes = 0;
+		IndexType edges = 0;
+		IndexType faces = 0;
+		unsigned int rounds = 0;
+	};
+
+	// the graph of a pattern with its node ids stored as Index, sizes stay IndexType
+	// PatternGraph picks the width, see there
+	template <typename Index>
+	class BasicPatternGraph
+	{
+	public:
 		struct Face
 		{
-			ofIndexType ids[3];
+			Index ids[3];
 		};
 
 		struct Edge
 		{
-			ofIndexType from = 0;
-			ofIndexType to = 0;
+			Index from = 0;
+			Index to = 0;
 			float distance = 0.f;
 		};
 
-		struct Node
+		// one array per field, indexed by node id, so a pass over the graph only loads the fields it reads
+		struct Nodes
 		{
-			ofIndexType id = 0;
+			std::vector<Index> last;
+			std::vector<Index> under;
+			std::vector<Index> next;
+			std::vector<Operation::Type> op;
 
-			ofIndexType last;
-			ofIndexType under;
-			ofIndexType next;
-
-			Data data;
+			IndexType size() const {
+				return op.size();
+			}
+			bool empty() const {
+				return op.empty();
+			}
 		};
 
 		class Graph
@@ -45,15 +86,13 @@ namespace ami
 			class NodeIterator
 			{
 			public:
-				NodeIterator(std::vector<Node> & nodes, ofIndexType id) : m_nodes(&nodes), id(id) {}
+				NodeIterator(Nodes & nodes, Index id) : id(id), m_nodes(&nodes) {}
 
-				NodeIterator last() { return NodeIterator(*m_nodes, node().last); }
-				NodeIterator under() { return NodeIterator(*m_nodes, node().under); }
-				NodeIterator next() { return NodeIterator(*m_nodes, node().next); }
+				NodeIterator last() { return NodeIterator(*m_nodes, NodeAccess::at(m_nodes->last, id)); }
+				NodeIterator under() { return NodeIterator(*m_nodes, NodeAccess::at(m_nodes->under, id)); }
+				NodeIterator next() { return NodeIterator(*m_nodes, NodeAccess::at(m_nodes->next, id)); }
 
-				Node & node() { return m_nodes->at(id); }
-
-				ofIndexType id;
+				Index id;
 
 				bool operator!=(NodeIterator & other)
 				{
@@ -81,20 +120,49 @@ namespace ami
 				}
 
 			private:
-				std::vector<Node> * m_nodes;
+				Nodes * m_nodes;
 			};
 
 			Graph() {}
+			Graph(Nodes nodes, std::vector<Edge> edges, std::vector<Face> faces)
+				:
+				m_nodes(std::move(nodes)),
+				m_edges(std::move(edges)),
+				m_faces(std::move(faces))
+			{}
+
+			// a node after all the others, last is the node before it, if any
+			NodeIterator addNode(Operation::Type op, Index last, Index under, Index next)
+			{
+				Index id = m_nodes.size();
+				m_nodes.last.push_back(last);
+				m_nodes.under.push_back(under);
+				m_nodes.next.push_back(next);
+				m_nodes.op.push_back(op);
+				return NodeIterator(m_nodes, id);
+			}
+
+			void reserve(IndexType nodes, IndexType edges, IndexType faces)
+			{
+				m_nodes.last.reserve(nodes);
+				m_nodes.under.reserve(nodes);
+				m_nodes.next.reserve(nodes);
+				m_nodes.op.reserve(nodes);
+				m_edges.reserve(edges);
+				m_faces.reserve(faces);
+			}
 
-			NodeIterator addNode()
+			void setUnder(Index node, Index under)
 			{
-				Node node;
-				node.id = m_nodes.size();
-				m_nodes.push_back(node);
-				return NodeIterator(m_nodes, node.id);
+				NodeAccess::at(m_nodes.under, node) = under;
 			}
 
-			void addEdge(ofIndexType from, ofIndexType to, float distance)
+			void setNext(Index node, Index next)
+			{
+				NodeAccess::at(m_nodes.next, node) = next;
+			}
+
+			void addEdge(Index from, Index to, float distance)
 			{
 				Edge edge;
 				edge.from = from;
@@ -103,7 +171,7 @@ namespace ami
 				m_edges.push_back(edge);
 			}
 
-			void addFace(ofIndexType a, ofIndexType b, ofIndexType c)
+			void addFace(Index a, Index b, Index c)
 			{
 				if (a == b || a == c || b == c) return; // check triangles are valid
 				Face face;
@@ -113,22 +181,34 @@ namespace ami
 				m_faces.push_back(face);
 			}
 
-			NodeIterator at(ofIndexType id)
+			// drops everything added after the first nodes, edges and faces, lastNext restores the next of the new last node
+			void truncate(IndexType nodes, IndexType edges, IndexType faces, Index lastNext)
+			{
+				m_nodes.last.resize(nodes);
+				m_nodes.under.resize(nodes);
+				m_nodes.next.resize(nodes);
+				m_nodes.op.resize(nodes);
+				m_edges.resize(edges);
+				m_faces.resize(faces);
+				if (!m_nodes.empty()) m_nodes.next.back() = lastNext;
+			}
+
+			NodeIterator at(Index id)
 			{ 
 				return NodeIterator(m_nodes, id);
 			}
 
 			NodeIterator front()
 			{
-				return NodeIterator(m_nodes, m_nodes.front().id);
+				return NodeIterator(m_nodes, 0);
 			}
 
 			NodeIterator back()
 			{
-				return NodeIterator(m_nodes, m_nodes.back().id);
+				return NodeIterator(m_nodes, m_nodes.size() - 1);
 			}
 
-			const std::vector<Node> & getNodes() const {
+			const Nodes & getNodes() const {
 				return m_nodes;
 			}
 			const std::vector<Edge> & getEdges() const {
@@ -139,14 +219,33 @@ namespace ami
 			}
 
 		private:
-			std::vector<Node> m_nodes;
+			Nodes m_nodes;
 			std::vector<Edge> m_edges;
 			std::vector<Face> m_faces;
 		};
 
-
-		PatternGraph(const PatternDef & pattern);
-		const std::vector<Node> & getNodes() const {
+		typedef GraphSize Size;
+
+		// nodes an Index holds ids for
+		static const std::uint64_t MaxNodes = std::uint64_t(std::numeric_limits<Index>::max()) + 1;
+
+		// an empty graph, rounds are added with addRounds
+		BasicPatternGraph() {}
+		// throws std::invalid_argument if the pattern has more than MaxNodes nodes
+		BasicPatternGraph(const PatternDef & pattern);
+		// the same graph, with its rounds built in parallel on pool
+		// throws std::invalid_argument where the serial build would, before building anything
+		BasicPatternGraph(const PatternDef & pattern, ThreadPool & pool);
+		// a graph built before, e.g. read back by PatternCache
+		BasicPatternGraph(Nodes nodes, std::vector<Edge> edges, std::vector<Face> faces)
+			:
+			m_graph(std::move(nodes), std::move(edges), std::move(faces))
+		{}
+		// the same graph with the ids of another width, they must fit in Index
+		template <typename OtherIndex>
+		explicit BasicPatternGraph(const BasicPatternGraph<OtherIndex> & other);
+
+		const Nodes & getNodes() const {
 			return m_graph.getNodes();
 		}
 		const std::vector<Edge> & getEdges() const {
@@ -156,10 +255,166 @@ namespace ami
 			return m_graph.getFaces();
 		}
 
+		// rounds whose end is known, 0 for a graph built from arrays
+		unsigned int getRoundCount() const {
+			return m_roundEnds.size();
+		}
+
+		// nodes added by the first rounds, they are the same in every graph of a pattern starting with the same rounds
+		IndexType getNodeCount(unsigned int rounds) const {
+			if (rounds == 0 || m_roundEnds.empty()) return 0;
+			return m_roundEnds[std::min<std::size_t>(rounds, m_roundEnds.size()) - 1].nodes;
+		}
+
+		// keeps the rounds before firstRound and adds the rounds of pattern from there on,
+		// pattern must have the same rounds before firstRound as the one the graph was built from
+		// nodes keep their ids, returns how many were kept
+		IndexType rebuild(const PatternDef & pattern, unsigned int firstRound);
+
+		// keeps the first rounds only, returns how many nodes are left
+		IndexType truncate(unsigned int rounds);
+
+		// adds the rounds of pattern from firstRound up to lastRound, not included, so a big pattern can be built in pieces
+		// the graph must hold the rounds before firstRound, and only those
+		// nothing is reserved, reserve the whole pattern first when building it in pieces
+		// throws std::invalid_argument once there are more than MaxNodes nodes
+		void addRounds(const PatternDef & pattern, unsigned int firstRound, unsigned int lastRound);
+
+		// makes room for size more nodes, edges, faces and rounds than the graph holds, so they are added without reallocating
+		void reserve(const Size & size);
+
 	private:
+		template <typename OtherIndex>
+		friend class BasicPatternGraph;
+
+		// sizes of the graph once a round is added
+		struct RoundEnd
+		{
+			IndexType nodes;
+			IndexType edges;
+			IndexType faces;
+			Index lastNext; // next of the last node, the first node of the following round changes it
+		};
+
 		void addOperation(Operation::Type type);
 
 		Graph m_graph;
+		std::vector<RoundEnd> m_roundEnds;
+
+	};
+
+	template <typename Index>
+	template <typename OtherIndex>
+	BasicPatternGraph<Index>::BasicPatternGraph(const BasicPatternGraph<OtherIndex> & other)
+	{
+		const typename BasicPatternGraph<OtherIndex>::Nodes & otherNodes = other.getNodes();
+		Nodes nodes;
+		nodes.last.assign(otherNodes.last.begin(), otherNodes.last.end());
+		nodes.under.assign(otherNodes.under.begin(), otherNodes.under.end());
+		nodes.next.assign(otherNodes.next.begin(), otherNodes.next.end());
+		nodes.op = otherNodes.op;
+
+		std::vector<Edge> edges(other.getEdges().size());
+		for (std::size_t e = 0; e < edges.size(); e++)
+		{
+			edges[e].from = other.getEdges()[e].from;
+			edges[e].to = other.getEdges()[e].to;
+			edges[e].distance = other.getEdges()[e].distance;
+		}
 
+		std::vector<Face> faces(other.getFaces().size());
+		for (std::size_t f = 0; f < faces.size(); f++)
+		{
+			for (unsigned int corner = 0; corner < 3; corner++)
+			{
+				faces[f].ids[corner] = other.getFaces()[f].ids[corner];
+			}
+		}
+
+		m_graph = Graph(std::move(nodes), std::move(edges), std::move(faces));
+		m_roundEnds.resize(other.m_roundEnds.size());
+		for (std::size_t round = 0; round < m_roundEnds.size(); round++)
+		{
+			const typename BasicPatternGraph<OtherIndex>::RoundEnd & otherEnd = other.m_roundEnds[round];
+			m_roundEnds[round].nodes = otherEnd.nodes;
+			m_roundEnds[round].edges = otherEnd.edges;
+			m_roundEnds[round].faces = otherEnd.faces;
+			m_roundEnds[round].lastNext = otherEnd.lastNext;
+		}
+	}
+
+	// the graph of a pattern, node ids stored as CompactIndexType when count() predicts at most 65536 nodes,
+	// ids 0 to 65535, IndexType otherwise. The mesh built from it follows its width, see PatternMesh
+	class PatternGraph
+	{
+	public:
+		typedef BasicPatternGraph<IndexType> WideGraph;
+		typedef BasicPatternGraph<CompactIndexType> CompactGraph;
+		typedef GraphSize Size;
+
+		// sizes of the graph of the rounds of pattern from firstRound on, from the operation counts alone
+		// nodes and edges are exact, faces and the edges closing a round with FO are upper bounds
+		static Size count(const PatternDef & pattern, unsigned int firstRound = 0);
+
+		// whether the ids of a graph of nodes nodes fit CompactIndexType
+		static bool fitsCompact(IndexType nodes) {
+			return nodes <= CompactGraph::MaxNodes;
+		}
+
+		// an empty graph, rounds are added with addRounds
+		// size is the count() of the whole pattern, it picks the width and is reserved
+		explicit PatternGraph(const Size & size = Size());
+		PatternGraph(const PatternDef & pattern);
+		// the same graph, with its rounds built in parallel on pool
+		// throws std::invalid_argument where the serial build would, before building anything
+		PatternGraph(const PatternDef & pattern, ThreadPool & pool);
+		// a graph built before, e.g. read back by PatternCache
+		explicit PatternGraph(WideGraph graph);
+		explicit PatternGraph(CompactGraph graph);
+
+		bool isCompact() const {
+			return m_bCompact;
+		}
+
+		// calls function with the graph in use, compact or wide
+		template <typename Function>
+		void withGraph(Function function) {
+			if (m_bCompact) function(m_compactGraph);
+			else function(m_graph);
+		}
+		template <typename Function>
+		void withGraph(Function function) const {
+			if (m_bCompact) function(m_compactGraph);
+			else function(m_graph);
+		}
+
+		IndexType getNodeCount() const {
+			return m_bCompact ? m_compactGraph.getNodes().size() : m_graph.getNodes().size();
+		}
+		IndexType getEdgeCount() const {
+			return m_bCompact ? m_compactGraph.getEdges().size() : m_graph.getEdges().size();
+		}
+		IndexType getFaceCount() const {
+			return m_bCompact ? m_compactGraph.getFaces().size() : m_graph.getFaces().size();
+		}
+
+		// see BasicPatternGraph
+		unsigned int getRoundCount() const {
+			return m_bCompact ? m_compactGraph.getRoundCount() : m_graph.getRoundCount();
+		}
+		IndexType getNodeCount(unsigned int rounds) const {
+			return m_bCompact ? m_compactGraph.getNodeCount(rounds) : m_graph.getNodeCount(rounds);
+		}
+
+		// see BasicPatternGraph, the width follows the new pattern, the rounds kept are converted when it changes
+		IndexType rebuild(const PatternDef & pattern, unsigned int firstRound);
+		// see BasicPatternGraph, a compact graph throws std::invalid_argument past 65536 nodes
+		void addRounds(const PatternDef & pattern, unsigned int firstRound, unsigned int lastRound);
+
+	private:
+		// only the graph of the width picked by the constructor is filled
+		bool m_bCompact = true;
+		WideGraph m_graph;
+		CompactGraph m_compactGraph;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,269 @@
+#include "PatternIndex.h"
+#include "Log.h"
+#include "PatternDigest.h"
+
+#include <cctype>
+#include <cstring>
+#include <istream>
+#include <stdexcept>
+#include <streambuf>
+
+namespace ami
+{
+	namespace
+	{
+		// read only stream over a piece of the mapping, nothing is copied
+		class MemoryBuffer : public std::streambuf
+		{
+		public:
+			MemoryBuffer(const char * data, std::size_t size)
+			{
+				char * begin = const_cast<char *>(data);
+				setg(begin, begin, begin + size);
+			}
+		};
+
+		bool startsWith(const char * data, std::size_t size, std::size_t pos, const char * token)
+		{
+			std::size_t length = std::strlen(token);
+			return size - pos >= length && std::memcmp(data + pos, token, length) == 0;
+		}
+
+		// position of token at or after pos, std::string::npos if missing
+		std::size_t find(const char * data, std::size_t size, std::size_t pos, const char * token)
+		{
+			std::size_t length = std::strlen(token);
+			while (pos + length <= size)
+			{
+				const void * first = std::memchr(data + pos, token[0], size - pos - length + 1);
+				if (!first) break;
+				pos = static_cast<const char *>(first) - data;
+				if (std::memcmp(data + pos, token, length) == 0) return pos;
+				pos++;
+			}
+			return std::string::npos;
+		}
+
+		// position of the closing '>' of the tag opening at pos, skipping quoted attribute values
+		std::size_t findTagEnd(const char * data, std::size_t size, std::size_t pos)
+		{
+			char quote = 0;
+			for (; pos < size; pos++)
+			{
+				char c = data[pos];
+				if (quote)
+				{
+					if (c == quote) quote = 0;
+				}
+				else if (c == '"' || c == '\'')
+				{
+					quote = c;
+				}
+				else if (c == '>')
+				{
+					return pos;
+				}
+			}
+			return std::string::npos;
+		}
+	}
+
+	bool PatternIndex::open(const std::string & file)
+	{
+		this->close();
+		m_name = file;
+
+		// binary patterns already start with their index
+		if (PatternBinary::isBinary(file))
+		{
+			m_binary.reset(new PatternBinary());
+			if (!m_binary->open(file))
+			{
+				LogError("PatternIndex") << m_binary->getError();
+				m_binary.reset();
+				return false;
+			}
+			m_count = m_binary->getPatternCount();
+		}
+		else
+		{
+			if (!m_file.open(file))
+			{
+				LogVerbose("PatternIndex") << "File " << file << " not found";
+				return false;
+			}
+			if (!this->scan())
+			{
+				this->close();
+				return false;
+			}
+			m_count = (unsigned int)m_ranges.size();
+		}
+
+		m_slots.reset(new Slot[m_count]);
+		m_bOpen = true;
+		return true;
+	}
+
+	void PatternIndex::close()
+	{
+		m_slots.reset();
+		m_ranges.clear();
+		m_file.close();
+		m_binary.reset();
+		m_count = 0;
+		m_bOpen = false;
+	}
+
+	const PatternDef & PatternIndex::getPattern(unsigned int pattern)
+	{
+		if (pattern >= m_count)
+		{
+			throw std::out_of_range("Pattern " + std::to_string(pattern) + " not found in " + m_name);
+		}
+
+		Slot & slot = m_slots[pattern];
+		std::lock_guard<std::mutex> lock(slot.mutex);
+		if (!slot.def)
+		{
+			// a failed parse leaves the slot empty, asking again throws again
+			slot.def.reset(new PatternDef(this->parse(pattern)));
+		}
+		return *slot.def;
+	}
+
+	PatternDef PatternIndex::parse(unsigned int pattern) const
+	{
+		if (m_binary)
+		{
+			return m_binary->getPattern(pattern);
+		}
+
+		const Range & range = m_ranges[pattern];
+		MemoryBuffer buffer(reinterpret_cast<const char *>(m_file.getData()) + range.begin, range.end - range.begin);
+		std::istream in(&buffer);
+
+		std::vector<PatternDef> patterns = PatternDigest::digest(in, m_name);
+		if (patterns.size() != 1)
+		{
+			throw std::invalid_argument("Pattern " + std::to_string(pattern) + " of " + m_name + " is not valid xml");
+		}
+		return std::move(patterns[0]);
+	}
+
+	bool PatternIndex::scan()
+	{
+		const char * data = reinterpret_cast<const char *>(m_file.getData());
+		std::size_t size = m_file.getSize();
+
+		// only tags are looked at: no attributes, text or entities are decoded
+		unsigned int depth = 0;
+		bool bPattern = false;
+		std::size_t patternBegin = 0;
+		bool bTerminated = true;
+		std::size_t pos = 0;
+		while (pos < size)
+		{
+			const void * tag = std::memchr(data + pos, '<', size - pos);
+			if (!tag) break;
+			pos = static_cast<const char *>(tag) - data;
+
+			std::size_t end;
+			if (startsWith(data, size, pos, "<!--"))
+			{
+				end = find(data, size, pos + 4, "-->");
+				if (end == std::string::npos)
+				{
+					bTerminated = false;
+					break;
+				}
+				pos = end + 3;
+				continue;
+			}
+			if (startsWith(data, size, pos, "<![CDATA["))
+			{
+				end = find(data, size, pos + 9, "]]>");
+				if (end == std::string::npos)
+				{
+					bTerminated = false;
+					break;
+				}
+				pos = end + 3;
+				continue;
+			}
+			if (startsWith(data, size, pos, "<?"))
+			{
+				end = find(data, size, pos + 2, "?>");
+				if (end == std::string::npos)
+				{
+					bTerminated = false;
+					break;
+				}
+				pos = end + 2;
+				continue;
+			}
+
+			end = findTagEnd(data, size, pos + 1);
+			if (end == std::string::npos)
+			{
+				bTerminated = false;
+				break;
+			}
+
+			if (data[pos + 1] == '!')
+			{
+				// doctype and other declarations
+			}
+			else if (data[pos + 1] == '/')
+			{
+				if (depth == 0)
+				{
+					LogError("PatternIndex") << m_name << ": end tag without start tag at byte " << pos;
+					return false;
+				}
+				depth--;
+				if (depth == 0 && bPattern)
+				{
+					m_ranges.push_back({ patternBegin, end + 1 });
+					bPattern = false;
+				}
+			}
+			else
+			{
+				bool bEmpty = data[end - 1] == '/';
+				if (depth == 0)
+				{
+					std::size_t nameEnd = pos + 1;
+					while (nameEnd < end && !std::isspace((unsigned char)data[nameEnd]) && data[nameEnd] != '/') nameEnd++;
+					bPattern = nameEnd - pos - 1 == 7 && std::memcmp(data + pos + 1, "Pattern", 7) == 0;
+					patternBegin = pos;
+				}
+				if (bEmpty)
+				{
+					if (depth == 0 && bPattern)
+					{
+						m_ranges.push_back({ patternBegin, end + 1 });
+						bPattern = false;
+					}
+				}
+				else
+				{
+					depth++;
+				}
+			}
+			pos = end + 1;
+		}
+
+		if (!bTerminated)
+		{
+			LogError("PatternIndex") << m_name << " is not valid xml: unterminated markup";
+			return false;
+		}
+		if (depth != 0)
+		{
+			LogError("PatternIndex") << m_name << " is not valid xml: unclosed element";
+			return false;
+		}
+		return true;
+	}
+}
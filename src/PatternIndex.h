@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "PatternBinary.h"
+#include "PatternDef.h"
+
+namespace ami
+{
+	// Index first access to the patterns of a file: open() only finds where each pattern is,
+	// a pattern is parsed the first time it is asked for and kept until the index is closed
+	// Binary .amib files open from their header alone, xml files with one pass skimming tags for <Pattern> boundaries
+	// getPattern can be called from several threads at once, each pattern is still parsed only once
+	class PatternIndex
+	{
+	public:
+		PatternIndex() {}
+
+		PatternIndex(const PatternIndex &) = delete;
+		PatternIndex & operator=(const PatternIndex &) = delete;
+
+		// false if the file is missing or its pattern boundaries cannot be found (unterminated markup, unbalanced tags)
+		// tags inside a pattern are only checked when it is parsed
+		// paths are used as given (the app resolves them with ofToDataPath)
+		bool open(const std::string & file);
+		void close();
+
+		bool isOpen() const {
+			return m_bOpen;
+		}
+
+		unsigned int getPatternCount() const {
+			return m_count;
+		}
+
+		// throws std::out_of_range for a missing pattern and std::invalid_argument if it does not parse,
+		// the reference stays valid until the index is closed or opened again
+		const PatternDef & getPattern(unsigned int pattern);
+
+	private:
+		// a lock per pattern, so different patterns parse in parallel
+		struct Slot
+		{
+			std::mutex mutex;
+			std::unique_ptr<PatternDef> def;
+		};
+
+		// byte range of one <Pattern> element in the mapped xml
+		struct Range
+		{
+			std::size_t begin;
+			std::size_t end;
+		};
+
+		PatternDef parse(unsigned int pattern) const;
+
+		// fills m_ranges with the top level <Pattern> elements, false on malformed markup
+		bool scan();
+
+		std::string m_name;
+		bool m_bOpen = false;
+		unsigned int m_count = 0;
+
+		// xml files
+		MappedFile m_file;
+		std::vector<Range> m_ranges;
+
+		// binary files
+		std::unique_ptr<PatternBinary> m_binary;
+
+		std::unique_ptr<Slot[]> m_slots;
+	};
+}
@@ -0,0 +1,174 @@
+#include "PatternLoader.h"
+#include "Log.h"
+#include "PatternIndex.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace ami
+{
+	PatternLoader::PatternLoader()
+		:
+		m_bCancel(false)
+	{
+		m_worker = std::thread(&PatternLoader::work, this);
+	}
+
+	PatternLoader::~PatternLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_bCancel = true;
+		m_wake.notify_all();
+		m_worker.join();
+	}
+
+	void PatternLoader::request(const std::string & file, const PatternCache & cache, const PatternCache::Solver & solver,
+		std::unique_ptr<Previous> previous)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_request.reset(new Request{ file, cache, solver, std::move(previous) });
+			// whatever is loading is older than this request
+			if (m_bLoading) m_bCancel = true;
+		}
+		m_wake.notify_all();
+	}
+
+	void PatternLoader::cancel()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_request.reset();
+		if (m_bLoading) m_bCancel = true;
+	}
+
+	std::unique_ptr<PatternLoader::Result> PatternLoader::poll()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return std::move(m_result);
+	}
+
+	bool PatternLoader::isBusy()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_request || m_bLoading;
+	}
+
+	PatternLoader::Progress PatternLoader::getProgress()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_progress;
+	}
+
+	bool PatternLoader::setProgress(Stage stage, float fraction)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_progress.stage = stage;
+		m_progress.fraction = fraction;
+		return !m_bCancel;
+	}
+
+	void PatternLoader::work()
+	{
+		while (true)
+		{
+			std::unique_ptr<Request> request;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this] { return m_bStop || m_request; });
+				if (m_bStop) return;
+
+				request = std::move(m_request);
+				m_bLoading = true;
+				m_bCancel = false;
+				m_progress = Progress();
+				m_progress.file = request->file;
+			}
+
+			std::unique_ptr<Result> result = this->load(*request);
+			if (!result) LogVerbose("PatternLoader") << "Cancelled " << request->file;
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				// an older result nobody picked up is stale now, a cancelled load leaves it
+				if (result) m_result = std::move(result);
+				m_bLoading = false;
+				m_progress = Progress();
+			}
+		}
+	}
+
+	std::unique_ptr<PatternLoader::Result> PatternLoader::load(Request & request)
+	{
+		std::unique_ptr<Result> result(new Result());
+		result->file = request.file;
+
+		try
+		{
+			this->setProgress(PARSE, 0.f);
+			PatternIndex index;
+			if (!index.open(request.file) || index.getPatternCount() == 0)
+			{
+				result->error = "No pattern in " + request.file;
+				return result;
+			}
+			result->pattern = index.getPattern(0);
+
+			result->key = PatternCache::getKey(result->pattern, request.solver);
+			PatternCache::Entry entry;
+			if (request.cache.load(result->key, request.solver, entry))
+			{
+				result->graph = std::move(entry.graph);
+				result->mesh = std::move(entry.mesh);
+				result->bCached = true;
+			}
+			else
+			{
+				if (!this->setProgress(GRAPH, 0.f)) return nullptr;
+
+				// a graph read from the cache has no rounds to keep
+				unsigned int firstChanged = 0;
+				const std::unique_ptr<Previous> & previous = request.previous;
+				if (previous && previous->graph && previous->graph->getRoundCount() == previous->pattern.getRounds().size())
+				{
+					firstChanged = previous->pattern.getSharedRounds(result->pattern);
+				}
+
+				if (firstChanged > 0)
+				{
+					// a reload only builds the rounds from the first changed one, on a copy the view never sees
+					result->graph.reset(new PatternGraph(*previous->graph));
+					result->graph->rebuild(result->pattern, firstChanged);
+					if (!this->setProgress(GRAPH, 1.f)) return nullptr;
+				}
+				else
+				{
+					// built a few rounds at a time, to report progress and stop soon after a cancel
+					unsigned int rounds = result->pattern.getRounds().size();
+					unsigned int roundStep = std::max(1u, rounds / 100);
+					// the count of the whole pattern picks the width of the ids before the first round is added
+					result->graph.reset(new PatternGraph(PatternGraph::count(result->pattern)));
+					for (unsigned int round = 0; round < rounds; round += roundStep)
+					{
+						result->graph->addRounds(result->pattern, round, round + roundStep);
+						if (!this->setProgress(GRAPH, std::min(round + roundStep, rounds) / float(rounds))) return nullptr;
+					}
+				}
+
+				if (!this->setProgress(MESH, 0.f)) return nullptr;
+				result->mesh = PatternMesh(*result->graph, request.solver.parameters);
+			}
+			if (!this->setProgress(MESH, 1.f)) return nullptr;
+		}
+		catch (std::exception & e)
+		{
+			result->error = request.file + ": " + e.what();
+			result->graph.reset();
+		}
+
+		LogVerbose("PatternLoader") << "Loaded " << request.file << (result->error.empty() ? "" : " with errors");
+		return result;
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "PatternCache.h"
+#include "PatternDef.h"
+#include "PatternGraph.h"
+#include "PatternMesh.h"
+
+namespace ami
+{
+	// Loads a pattern file on a worker thread: digest, graph and mesh, or the relaxed mesh from the cache
+	// Nothing shared with the caller is touched while loading, the result is picked up with poll()
+	class PatternLoader
+	{
+	public:
+		enum Stage {
+			IDLE,
+			PARSE,
+			GRAPH,
+			MESH
+		};
+
+		struct Progress
+		{
+			std::string file;
+			Stage stage = IDLE;
+			float fraction = 0.f; // of the stage, the graph advances by rounds, parse and mesh only from 0 to 1
+		};
+
+		struct Result
+		{
+			std::string file;
+			PatternDef pattern;
+			std::unique_ptr<PatternGraph> graph;
+			PatternMesh mesh;
+			std::uint64_t key = 0; // cache key of pattern with the solver it was loaded for
+			bool bCached = false; // mesh is already relaxed, read from the cache
+			std::string error; // empty if the load succeeded
+		};
+
+		// the pattern shown when a reload is requested, its graph is rebuilt from the first changed round
+		struct Previous
+		{
+			PatternDef pattern;
+			std::shared_ptr<const PatternGraph> graph; // shared with the view, the worker copies it before rebuilding
+		};
+
+		PatternLoader();
+		// cancels the load in progress and waits for it to stop
+		~PatternLoader();
+
+		PatternLoader(const PatternLoader &) = delete;
+		PatternLoader & operator=(const PatternLoader &) = delete;
+
+		// loads the first pattern of file in the background
+		// with previous, the rounds the pattern shares with it are kept instead of being built again
+		// a request not started yet is replaced, the load in progress is cancelled
+		void request(const std::string & file, const PatternCache & cache, const PatternCache::Solver & solver,
+			std::unique_ptr<Previous> previous = nullptr);
+
+		// drops the request waiting and the load in progress, a finished result not picked up yet is kept
+		void cancel();
+
+		// the last finished load, or null, never blocks
+		std::unique_ptr<Result> poll();
+
+		// a request is waiting or loading
+		bool isBusy();
+
+		// stage of the load in progress, IDLE if there is none
+		Progress getProgress();
+
+	private:
+		struct Request
+		{
+			std::string file;
+			PatternCache cache;
+			PatternCache::Solver solver;
+			std::unique_ptr<Previous> previous;
+		};
+
+		void work();
+		// null if the load was cancelled
+		std::unique_ptr<Result> load(Request & request);
+		// false once the load in progress is cancelled
+		bool setProgress(Stage stage, float fraction);
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::unique_ptr<Request> m_request;
+		std::unique_ptr<Result> m_result;
+		Progress m_progress;
+		bool m_bLoading = false;
+		bool m_bStop = false;
+		// checked between rounds, without the mutex
+		std::atomic<bool> m_bCancel;
+
+		std::thread m_worker;
+	};
+}
@@ -1,271 +1,507 @@
 #include "PatternMesh.h"
 
-#include "ofGraphics.h"
+#include "Log.h"
 
+#include <algorithm>
+#include <cmath>
 #include <numeric>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
 
 namespace ami
 {
+	PatternMesh::PatternMesh()
+		:
+		m_centerX (0.0f),
+		m_centerY (0.0f),
+		m_centerZ (0.0f),
+		m_roundNum (0),
+		m_pointDistance (Parameters().pointDistance),
+		m_minTension (0.1f),
+		m_damping (Parameters().damping),
+		m_expansion (Parameters().expansion),
+		m_solveIterations (Parameters().solveIterations)
+	{}
+
 	PatternMesh::PatternMesh(const PatternGraph & graph)
 		:
-		m_pointDistance (1.0f),
+		PatternMesh(graph, Parameters())
+	{}
+
+	PatternMesh::PatternMesh(const PatternGraph & graph, const Parameters & parameters)
+		:
+		m_centerX (0.0f),
+		m_centerY (0.0f),
+		m_centerZ (0.0f),
 		m_roundNum (0),
+		m_pointDistance (parameters.pointDistance),
 		m_minTension (0.1f),
-		m_damping (0.1f),
-		m_solveIterations (5)
+		m_damping (parameters.damping),
+		m_expansion (parameters.expansion),
+		m_solveIterations (parameters.solveIterations)
 	{
-
-		unsigned int nodeIndex = 0; 
-		for (auto & node : graph.getNodes())
+		// the graph is final, every buffer is sized from it once, with the width of its ids
+		m_bCompact = graph.isCompact();
+		m_x.reserve(graph.getNodeCount());
+		m_y.reserve(graph.getNodeCount());
+		m_z.reserve(graph.getNodeCount());
+		this->withConstraints([&](auto & con) { con.hard.reserve(graph.getEdgeCount()); });
+
+		for (IndexType nodeIndex = 0; nodeIndex < graph.getNodeCount(); nodeIndex++)
 		{
 			float heightInc = m_pointDistance;
 			float radius = m_pointDistance * 2.0f;
 			float height = heightInc*nodeIndex/ 10.f;
 			
-			glm::vec3 vertex(0, height, -radius);
-			vertex = glm::rotate(vertex, nodeIndex/10.f * (float)TWO_PI, glm::vec3(0.0f, 1.0f, 0.0f));
+			// (0, height, -radius) rotated around the y axis
+			float angle = nodeIndex/10.f * TwoPi;
 
-			m_mesh.addVertex(vertex);
-			m_oldVec.push_back(vertex);
-
-			nodeIndex++;
+			m_x.push_back(-radius * std::sin(angle));
+			m_y.push_back(height);
+			m_z.push_back(-radius * std::cos(angle));
 		}
 
-		for (auto & edge : graph.getEdges())
+		// the indices of the mesh have the width of the graph, they are copied as they are
+		graph.withGraph([&](const auto & built)
 		{
-			setDistanceConstrain(edge.from, edge.to, edge.distance * m_pointDistance);
-		}
-		
-		for (auto & face : graph.getFaces())
+			for (auto & edge : built.getEdges())
+			{
+				setDistanceConstrain(edge.from, edge.to, edge.distance * m_pointDistance);
+			}
+
+			this->withIndices([&](auto & indices)
+			{
+				indices.reserve(built.getFaces().size() * 3);
+				for (auto & face : built.getFaces())
+				{
+					indices.insert(indices.end(), &face.ids[0], &face.ids[0] + 3);
+				}
+			});
+		});
+
+		m_oldX = m_x;
+		m_oldY = m_y;
+		m_oldZ = m_z;
+		// vertex to face incidence: count faces per vertex, prefix sum into offsets, then scatter
+		this->withIndices([&](const auto & indices)
 		{
-			m_mesh.addIndices(&face.ids[0], 3);
-		}
+			m_vertexFaceOffsets.assign(m_x.size() + 1, 0);
+			for (IndexType index : indices)
+			{
+				m_vertexFaceOffsets[index + 1]++;
+			}
+			for (IndexType v = 0; v < m_x.size(); v++)
+			{
+				m_vertexFaceOffsets[v + 1] += m_vertexFaceOffsets[v];
+			}
+			m_vertexFaces.resize(indices.size());
+			std::vector<IndexType> cursor(m_vertexFaceOffsets.begin(), m_vertexFaceOffsets.end() - 1);
+			for (IndexType i = 0; i < indices.size(); i++)
+			{
+				m_vertexFaces[cursor[indices[i]]++] = i / 3;
+			}
+		});
+
+		m_normalX.assign(m_x.size(), 0.0f);
+		m_normalY.assign(m_x.size(), 0.0f);
+		m_normalZ.assign(m_x.size(), 0.0f);
+
+		this->withConstraints([&](auto & con)
+		{
+			con.hard.build(m_x.size());
+			con.soft.build(m_x.size());
+		});
+		m_expansionX.assign(m_x.size(), 0.0f);
+		m_expansionY.assign(m_x.size(), 0.0f);
+		m_expansionZ.assign(m_x.size(), 0.0f);
+
+		LogVerbose("PatternMesh") << "Constraint kernel: " << DistanceKernel::getString(DistanceKernel::getIsa())
+			<< (m_bCompact ? ", 16 bit indices" : ", 32 bit indices");
 	}
 
-	void PatternMesh::setDistanceConstrain(ofIndexType a, ofIndexType b, float distance)
+	void PatternMesh::setDistanceConstrain(IndexType a, IndexType b, float distance)
 	{
 		// merging vertices does not add triangles, just adds a hard constraint of 0 distance between the vertices
-		m_con[a].insert({ b, distance });
-		m_con[b].insert({ a, distance });
+		this->withConstraints([&](auto & con) { con.hard.add(a, b, distance); });
 	}
-	void PatternMesh::setAngleConstrain(ofIndexType a, ofIndexType b, float degrees)
+	void PatternMesh::setAngleConstrain(IndexType a, IndexType b, float degrees)
 	{
 		float A2 = m_pointDistance*m_pointDistance;
 
-		float distance = std::sqrt(2*A2*( 1 - std::cos(degrees * DEG_TO_RAD )));
+		float distance = std::sqrt(2*A2*( 1 - std::cos(degrees * DegToRad )));
 
-		m_soft_con[a].insert({ b, distance });
-		m_soft_con[b].insert({ a, distance });
+		this->withConstraints([&](auto & con) { con.soft.add(a, b, distance); });
 	}
 
-	void PatternMesh::update(float deltaTime)
+	void PatternMesh::setThreadCount(unsigned int threads)
 	{
-		this->updateNormals();
-		this->computeForces();
-		this->verletUpdate(deltaTime);
+		threads = std::max(threads, 1u);
+		if (m_pool && m_pool->getThreadCount() == threads) return;
 
-		// solve constraints
-		for (unsigned int i = 0; i < m_solveIterations; i++)
-		{
-			this->solveConstraints();
-		}
+		m_pool = std::make_shared<ThreadPool>(threads);
+	}
 
-		this->updateCenter();
-		// center mesh
-		for (auto & vert : m_mesh.getVertices())
+	void PatternMesh::setSolveIterations(unsigned int iterations)
+	{
+		m_solveIterations = iterations;
+	}
+
+	PatternMesh::Parameters PatternMesh::getParameters() const
+	{
+		Parameters parameters;
+		parameters.pointDistance = m_pointDistance;
+		parameters.damping = m_damping;
+		parameters.expansion = m_expansion;
+		parameters.solveIterations = m_solveIterations;
+		return parameters;
+	}
+
+	void PatternMesh::setPositions(const AlignedFloats & x, const AlignedFloats & y, const AlignedFloats & z)
+	{
+		if (x.size() != m_x.size() || y.size() != m_x.size() || z.size() != m_x.size())
 		{
-			vert.x -= m_center.x;
-			vert.z -= m_center.z;
+			throw std::invalid_argument("Positions for " + std::to_string(x.size()) + " vertices, the mesh has " + std::to_string(m_x.size()));
 		}
+
+		m_x = x;
+		m_y = y;
+		m_z = z;
+		m_oldX = x;
+		m_oldY = y;
+		m_oldZ = z;
+		this->updateNormals();
 	}
 
-	void PatternMesh::verletUpdate(float deltaTime)
+	void PatternMesh::warmStart(const PatternMesh & previous, IndexType keptVertices, const PatternGraph & graph)
 	{
-		float dt2 = deltaTime * deltaTime;
-		// verlet update
-		for (auto & con = m_con.begin(); con != m_con.end(); con++)
+		if (graph.getNodeCount() != m_x.size())
 		{
-			glm::vec3 & expansion = m_expansionForce[con->first];
-			glm::vec3 & vertex = m_mesh.getVertices()[con->first];
-			glm::vec3 & oldVertex = m_oldVec[con->first];
+			throw std::invalid_argument("The mesh was not built from this graph");
+		}
 
-			glm::vec3 acc = expansion; // inner expansion
-			glm::vec3 vel = vertex - oldVertex; // velocity is last distance (inertia, no need for dt)
-			oldVertex = vertex;
+		keptVertices = std::min(keptVertices, std::min(previous.getVertexCount(), this->getVertexCount()));
+		if (keptVertices == 0) return; // nothing to start from, the spiral stays
 
-			glm::vec3 acceleration = acc * dt2;
-			glm::vec3 velocity = vel * m_damping;
-			vertex = vertex + velocity + acceleration;
-		}
+		std::copy(previous.m_x.begin(), previous.m_x.begin() + keptVertices, m_x.begin());
+		std::copy(previous.m_y.begin(), previous.m_y.begin() + keptVertices, m_y.begin());
+		std::copy(previous.m_z.begin(), previous.m_z.begin() + keptVertices, m_z.begin());
+		std::copy(previous.m_oldX.begin(), previous.m_oldX.begin() + keptVertices, m_oldX.begin());
+		std::copy(previous.m_oldY.begin(), previous.m_oldY.begin() + keptVertices, m_oldY.begin());
+		std::copy(previous.m_oldZ.begin(), previous.m_oldZ.begin() + keptVertices, m_oldZ.begin());
+
+		// new vertices continue the direction from the stitch under their under to their under, in order,
+		// so the unders of later new vertices are already placed
+		graph.withGraph([&](const auto & built)
+		{
+			const auto & unders = built.getNodes().under;
+			for (IndexType v = keptVertices; v < m_x.size(); v++)
+			{
+				IndexType under = unders[v];
+				IndexType below = unders[under];
+
+				float dx = m_x[under] - m_x[below];
+				float dy = m_y[under] - m_y[below];
+				float dz = m_z[under] - m_z[below];
+				float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+				IndexType base = under;
+				if (under >= v || length == 0.0f)
+				{
+					// no row to follow: above the previous vertex
+					base = v - 1;
+					dx = 0.0f;
+					dy = 1.0f;
+					dz = 0.0f;
+					length = 1.0f;
+				}
+
+				float scale = m_pointDistance / length;
+				m_x[v] = m_x[base] + dx * scale;
+				m_y[v] = m_y[base] + dy * scale;
+				m_z[v] = m_z[base] + dz * scale;
+				m_oldX[v] = m_x[v];
+				m_oldY[v] = m_y[v];
+				m_oldZ[v] = m_z[v];
+			}
+		});
+		// normals are left to the next update(), this runs between frames
 	}
 
-	void PatternMesh::solveConstraints()
+	float PatternMesh::getMaxDeformation() const
 	{
-		// solve constrains
-		for (auto & con = m_con.begin(); con != m_con.end(); con++)
+		// compare every constraint length before and after the last update
+		// lengths ignore rigid motion, and a relaxed mesh keeps slowly drifting and spinning
+		float maxDeformation = 0.0f;
+		this->withConstraints([&](const auto & con)
 		{
-			glm::vec3 & point0 = m_mesh.getVertices()[con->first];
-
-			for (auto & index : con->second)
+			for (IndexType c = 0; c < con.hard.size(); c++)
 			{
-				glm::vec3 & point1 = m_mesh.getVertices()[index.first];
-				glm::vec3 distVec = point0 - point1;
-				float dist = glm::length(distVec);
-				if (dist == 0.0f) dist = std::numeric_limits<float>::epsilon(); // check for zero division
-				glm::vec3 tension = distVec * (index.second - dist) / dist;
-
-				point0 += tension * 0.5f; // update vertex following constraint
-				point1 -= tension * 0.5f; // update vertex following constraint
+				IndexType a = con.hard.getA(c);
+				IndexType b = con.hard.getB(c);
+
+				float dx = m_x[a] - m_x[b];
+				float dy = m_y[a] - m_y[b];
+				float dz = m_z[a] - m_z[b];
+				float oldDx = m_oldX[a] - m_oldX[b];
+				float oldDy = m_oldY[a] - m_oldY[b];
+				float oldDz = m_oldZ[a] - m_oldZ[b];
+
+				float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+				float oldLength = std::sqrt(oldDx * oldDx + oldDy * oldDy + oldDz * oldDz);
+				maxDeformation = std::max(maxDeformation, std::abs(length - oldLength));
 			}
+		});
+		return maxDeformation;
+	}
 
-			m_mesh.getVertices()[0] = ofVec3f(0); // insist on this constraint
-		}
-		
-		// solve soft constrains
-		for (auto & con = m_soft_con.begin(); con != m_soft_con.end(); con++)
+	IndexType PatternMesh::getConstraintCount() const
+	{
+		IndexType count = 0;
+		this->withConstraints([&](const auto & con) { count = con.hard.size(); });
+		return count;
+	}
+
+	void PatternMesh::getConstraints(std::vector<IndexType> & a, std::vector<IndexType> & b, std::vector<float> & distances) const
+	{
+		this->withConstraints([&](const auto & con)
 		{
-			glm::vec3 & point0 = m_mesh.getVertices()[con->first];
+			a.assign(con.hard.getAs().begin(), con.hard.getAs().end());
+			b.assign(con.hard.getBs().begin(), con.hard.getBs().end());
+			distances = con.hard.getDistances();
+		});
+	}
 
-			for (auto & index : con->second)
+	bool PatternMesh::save(const std::string & file) const
+	{
+		std::ofstream out(file);
+		if (!out)
+		{
+			LogError("PatternMesh") << "Could not write " << file;
+			return false;
+		}
+
+		for (IndexType v = 0; v < m_x.size(); v++)
+		{
+			out << "v " << m_x[v] << " " << m_y[v] << " " << m_z[v] << "\n";
+		}
+		for (IndexType v = 0; v < m_x.size(); v++)
+		{
+			out << "vn " << m_normalX[v] << " " << m_normalY[v] << " " << m_normalZ[v] << "\n";
+		}
+		// obj indices start at 1
+		this->withIndices([&](const auto & indices)
+		{
+			for (IndexType i = 0; i + 2 < indices.size(); i += 3)
 			{
-				glm::vec3 & point1 = m_mesh.getVertices()[index.first];
-				glm::vec3 distVec = point0 - point1;
-				float dist = glm::length(distVec);
-				// apply tension only if the distance is smaller than the desired distance
-				if (index.second < dist)
+				out << "f";
+				for (IndexType corner = 0; corner < 3; corner++)
 				{
-					if (dist == 0.0f) dist = std::numeric_limits<float>::epsilon(); // check for zero division
-					glm::vec3 tension = distVec * (index.second - dist) / dist;
-
-					point0 += tension * 0.5f; // update vertex following constraint
-					point1 -= tension * 0.5f; // update vertex following constraint
+					IndexType index = indices[i + corner] + 1;
+					out << " " << index << "//" << index;
 				}
+				out << "\n";
 			}
-		}
+		});
+
+		return bool(out);
 	}
 
-	void PatternMesh::computeForces()
+	void PatternMesh::update(float deltaTime)
 	{
-		for (auto & con = m_con.begin(); con != m_con.end(); con++)
+		this->updateNormals();
+		this->computeForces();
+		this->verletUpdate(deltaTime);
+
+		// solve constraints
+		for (unsigned int i = 0; i < m_solveIterations; i++)
 		{
-			// expansion
-			glm::vec3 avgNormal;
-			for (auto & index : con->second)
-			{
-				// compute average normal of neighbours
-				avgNormal += m_mesh.getNormal(index.first);
-			}
-			if (!con->second.empty())
-			{
-				avgNormal /= con->second.size();
-			}
+			this->solveConstraints();
+		}
 
-			m_expansionForce[con->first] = avgNormal * 2000.0f;
+		this->updateCenter();
+		// center mesh
+		for (IndexType v = 0; v < m_x.size(); v++)
+		{
+			m_x[v] -= m_centerX;
+			m_z[v] -= m_centerZ;
 		}
 	}
 
-	void PatternMesh::updateCenter()
+	void PatternMesh::verletUpdate(float deltaTime)
 	{
-		// find mesh center
-		m_center = std::accumulate(m_mesh.getVertices().begin(), m_mesh.getVertices().end(), glm::vec3(0));
-		m_center /= m_mesh.getNumVertices();
+		float dt2 = deltaTime * deltaTime;
+		// verlet update, the adjacency offsets are IndexType with either width
+		const std::vector<IndexType> & offsets = m_bCompact ? m_compactCon.hard.getAdjacency().getOffsets() : m_con.hard.getAdjacency().getOffsets();
+		for (IndexType v = 0; v + 1 < offsets.size(); v++)
+		{
+			if (offsets[v] == offsets[v + 1]) continue; // unconstrained vertices are not simulated
+
+			// velocity is last distance (inertia, no need for dt), acceleration is the inner expansion
+			float x = m_x[v] + (m_x[v] - m_oldX[v]) * m_damping + m_expansionX[v] * dt2;
+			float y = m_y[v] + (m_y[v] - m_oldY[v]) * m_damping + m_expansionY[v] * dt2;
+			float z = m_z[v] + (m_z[v] - m_oldZ[v]) * m_damping + m_expansionZ[v] * dt2;
+
+			m_oldX[v] = m_x[v];
+			m_oldY[v] = m_y[v];
+			m_oldZ[v] = m_z[v];
+			m_x[v] = x;
+			m_y[v] = y;
+			m_z[v] = z;
+		}
 	}
 
-	void PatternMesh::updateNormals()
+	void PatternMesh::solveConstraints()
 	{
-		m_mesh.clearNormals();
+		// solve constrains, each undirected constraint once
+		this->withConstraints([this](const auto & con) { this->solveColors(con.hard, false); });
 
-		unsigned int nVertices = m_mesh.getVertices().size();
-		unsigned int nIndices = m_mesh.getIndices().size();
+		if (!m_x.empty())
+		{
+			// insist on this constraint
+			m_x[0] = 0.0f;
+			m_y[0] = 0.0f;
+			m_z[0] = 0.0f;
+		}
+		
+		// solve soft constrains, they only pull when longer than their distance
+		this->withConstraints([this](const auto & con) { this->solveColors(con.soft, true); });
+	}
 
-		std::vector<int> vertexFaceCount(nVertices);
-		std::vector< glm::vec3 > vertexNormals(nVertices);
-		std::vector< glm::vec3 > faceNormals = m_mesh.getFaceNormals();
+	template <typename Index>
+	void PatternMesh::solveColors(const BasicConstraints<Index> & constraints, bool bStretchOnly)
+	{
+		const unsigned int minChunk = 2048; // constraints per thread worth waking a worker for
+
+		DistanceKernel::Function<Index> project = DistanceKernel::getFunction<Index>();
+		DistanceKernel::Positions positions = { m_x.data(), m_y.data(), m_z.data() };
 
-		for (unsigned int i = 0; i < nIndices; i++)
+		auto solveRange = [&](IndexType begin, IndexType end)
 		{
-			int vertex = m_mesh.getIndices()[i];
-			int face = ((int)(i / 3)) * 3; //OF issue, getFaceNormals() iterates +=3, so faceNormals should move like: 0, 3, 6, 9...
-			vertexNormals[vertex] += faceNormals[face];
-			vertexFaceCount[vertex]++;
-		}
-		for (unsigned int i = 0; i < vertexNormals.size(); i++)
+			project(positions, constraints.getAs().data(), constraints.getBs().data(), constraints.getDistances().data(), begin, end, bStretchOnly);
+		};
+
+		// colors run in order, constraints inside a color have no shared vertices and can be split between threads and SIMD lanes
+		for (unsigned int color = 0; color < constraints.getColorCount(); color++)
 		{
-			vertexNormals[i] /= vertexFaceCount[i];
-			vertexNormals[i] = glm::normalize(vertexNormals[i]);
+			this->parallelFor(constraints.getColorBegin(color), constraints.getColorEnd(color), minChunk, solveRange);
 		}
-
-		m_mesh.addNormals(vertexNormals);
 	}
 
-	void PatternMesh::draw()
+	void PatternMesh::parallelFor(IndexType begin, IndexType end, unsigned int minChunk, const ThreadPool::RangeFunction & function)
 	{
-		ofPushStyle();
-		ofDisableDepthTest();
-		ofEnableBlendMode(ofBlendMode::OF_BLENDMODE_ALPHA);
-		ofSetColor(255);
-		glPointSize(5.0f);
-		m_mesh.drawVertices();
-		//ofSetColor(200, 50);
-		//m_mesh.draw();
-		ofSetColor(200);
-		m_mesh.drawWireframe();
-		//ofSetColor(ofColor::red);
-		//for (auto & tension : m_tension)
-		//{
-		//	glm::vec3 start = m_mesh.getVertex(tension.first);
-		//	glm::vec3 end = start + tension.second;
-		//	glBegin(GL_LINES);
-		//	glVertex3f(start.x, start.y, start.z);
-		//	glVertex3f(end.x, end.y, end.z);
-		//	glEnd();
-		//}
-		//ofSetColor(ofColor::blue);
-		//for (auto & tension : m_constraintTension)
-		//{
-		//	glm::vec3 start = m_mesh.getVertex(tension.first);
-		//	glm::vec3 end = start + tension.second;
-		//	glBegin(GL_LINES);
-		//	glVertex3f(start.x, start.y, start.z);
-		//	glVertex3f(end.x, end.y, end.z);
-		//	glEnd();
-		//}
-
-
-		ofSetColor(ofColor::green);
-		for (auto & tension : m_expansionForce)
+		if (m_pool)
 		{
-			glm::vec3 start = m_mesh.getVertex(tension.first);
-			glm::vec3 end = start + glm::normalize(tension.second);
-			glBegin(GL_LINES);
-			glVertex3f(start.x, start.y, start.z);
-			glVertex3f(end.x, end.y, end.z);
-			glEnd();
+			m_pool->parallelFor(begin, end, minChunk, function);
 		}
-		
-		ofSetLineWidth(2.0f);
-		ofSetColor(ofColor::red);
-		for (auto & con = m_con.begin(); con != m_con.end(); con++)
+		else
 		{
-			glm::vec3 & point0 = m_mesh.getVertices()[con->first];
+			function(begin, end);
+		}
+	}
 
-			for (auto & index : con->second)
+	void PatternMesh::computeForces()
+	{
+		const unsigned int minChunk = 1024; // vertices per thread worth waking a worker for
+
+		// expansion is the average of the neighbour normals, scaled by the expansion strength
+		// rows stream through the packed neighbours, and each row writes only its own vertex
+		this->withConstraints([this, minChunk](const auto & con)
+		{
+			const auto & adjacency = con.hard.getAdjacency();
+			auto expansionRange = [this, &adjacency](IndexType begin, IndexType end)
 			{
-				glm::vec3 & point1 = m_mesh.getVertices()[index.first];
+				const IndexType * offsets = adjacency.getOffsets().data();
+				const auto * neighbours = adjacency.getNeighbours().data();
 
-				glm::vec3 start = point0;
-				glm::vec3 end = point0 + glm::normalize(point1 - point0) * index.second; // show the correct distance
+				for (IndexType v = begin; v < end; v++)
+				{
+					IndexType degree = offsets[v + 1] - offsets[v];
+					if (degree == 0)
+					{
+						m_expansionX[v] = 0.0f;
+						m_expansionY[v] = 0.0f;
+						m_expansionZ[v] = 0.0f;
+						continue;
+					}
+
+					float x = 0.0f;
+					float y = 0.0f;
+					float z = 0.0f;
+					for (IndexType n = offsets[v]; n < offsets[v + 1]; n++)
+					{
+						x += m_normalX[neighbours[n]];
+						y += m_normalY[neighbours[n]];
+						z += m_normalZ[neighbours[n]];
+					}
+
+					// sum, divide, then scale, in the order the expansion was always computed
+					m_expansionX[v] = x / degree * m_expansion;
+					m_expansionY[v] = y / degree * m_expansion;
+					m_expansionZ[v] = z / degree * m_expansion;
+				}
+			};
 
-				glBegin(GL_LINES);
-				glVertex3f(start.x, start.y, start.z);
-				glVertex3f(end.x, end.y, end.z);
-				glEnd();
-			}
-		}
+			this->parallelFor(0, adjacency.getVertexCount(), minChunk, expansionRange);
+		});
+	}
 
-		ofPopStyle();
+	void PatternMesh::updateCenter()
+	{
+		// find mesh center
+		m_centerX = std::accumulate(m_x.begin(), m_x.end(), 0.0f) / m_x.size();
+		m_centerY = std::accumulate(m_y.begin(), m_y.end(), 0.0f) / m_x.size();
+		m_centerZ = std::accumulate(m_z.begin(), m_z.end(), 0.0f) / m_x.size();
 	}
 
-}
+	void PatternMesh::updateNormals()
+	{
+		const unsigned int minChunk = 1024; // vertices per thread worth waking a worker for
+
+		// single fused pass: every vertex sums the cross products of its faces, computed on the spot
+		// the cross product length is twice the face area, so larger faces weight more
+		// vertices only read shared data and write their own normal, so ranges run in parallel
+		this->withIndices([&](const auto & indices)
+		{
+			auto normalRange = [this, &indices](IndexType begin, IndexType end)
+			{
+				const float * x = m_x.data();
+				const float * y = m_y.data();
+				const float * z = m_z.data();
 
+				for (IndexType vertex = begin; vertex < end; vertex++)
+				{
+					float nx = 0.0f;
+					float ny = 0.0f;
+					float nz = 0.0f;
+
+					for (IndexType f = m_vertexFaceOffsets[vertex]; f < m_vertexFaceOffsets[vertex + 1]; f++)
+					{
+						const auto * face = &indices[m_vertexFaces[f] * 3];
+
+						float ux = x[face[1]] - x[face[0]];
+						float uy = y[face[1]] - y[face[0]];
+						float uz = z[face[1]] - z[face[0]];
+						float vx = x[face[2]] - x[face[0]];
+						float vy = y[face[2]] - y[face[0]];
+						float vz = z[face[2]] - z[face[0]];
+
+						nx += uy * vz - uz * vy;
+						ny += uz * vx - ux * vz;
+						nz += ux * vy - uy * vx;
+					}
+
+					float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+					float scale = length > 0.0f ? 1.0f / length : 0.0f; // vertices without faces keep a zero normal
+
+					m_normalX[vertex] = nx * scale;
+					m_normalY[vertex] = ny * scale;
+					m_normalZ[vertex] = nz * scale;
+				}
+			};
 
+			this->parallelFor(0, m_x.size(), minChunk, normalRange);
+		});
+	}
+}
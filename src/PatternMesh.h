@@ -1,52 +1,204 @@
 #pragma once
 
-#include "ofMesh.h"
 #include "PatternDef.h"
 
-#include <set>
 #include "PatternGraph.h"
+#include "PatternConstraints.h"
+#include "ThreadPool.h"
+#include "DistanceKernel.h"
+#include "AlignedAllocator.h"
+
+#include <map>
+#include <memory>
+#include <string>
 
 namespace ami
 {
+	// Relaxes the graph of a pattern as a verlet cloth, with no rendering or openFrameworks dependency
 	class PatternMesh
 	{
 	public:
-		PatternMesh() {};
+		// everything the relaxed shape depends on besides the graph
+		struct Parameters
+		{
+			float pointDistance = 1.0f; // length of a stitch
+			float damping = 0.1f; // fraction of the velocity kept every step
+			float expansion = 2000.0f; // strength of the stuffing pushing along the normals
+			unsigned int solveIterations = 5; // constraint solver passes per update
+		};
+
+		// no vertices, with the default parameters
+		PatternMesh();
 		PatternMesh(const PatternGraph & graph);
+		PatternMesh(const PatternGraph & graph, const Parameters & parameters);
 
 		void update(float deltaTime);
 
-		void draw();
+		// recompute the vertex normals from the current positions, update() already does it every step
+		void updateNormals();
+
+		// threads used to project each color batch of constraints, 1 solves on the calling thread only
+		void setThreadCount(unsigned int threads);
+
+		// constraint solver passes per update
+		void setSolveIterations(unsigned int iterations);
+
+		Parameters getParameters() const;
+
+		// replaces the positions, at rest (previous positions equal), e.g. a relaxed shape from PatternCache
+		// throws std::invalid_argument if the vertex count does not match
+		void setPositions(const AlignedFloats & x, const AlignedFloats & y, const AlignedFloats & z);
+
+		// warm start after PatternGraph::rebuild: the first keptVertices continue from previous, velocity included,
+		// the others start one stitch beyond the vertex they are worked into instead of on the spiral
+		// graph is the one this mesh was built from
+		void warmStart(const PatternMesh & previous, IndexType keptVertices, const PatternGraph & graph);
+
+		// largest change of a constraint length during the last update, to detect a settled mesh
+		float getMaxDeformation() const;
+
+		IndexType getVertexCount() const {
+			return m_x.size();
+		}
+
+		// write positions, normals and faces as a Wavefront OBJ file
+		bool save(const std::string & file) const;
+
+		// simulation state for renderers and exporters, one entry per vertex
+		const AlignedFloats & getX() const {
+			return m_x;
+		}
+		const AlignedFloats & getY() const {
+			return m_y;
+		}
+		const AlignedFloats & getZ() const {
+			return m_z;
+		}
+		const AlignedFloats & getNormalX() const {
+			return m_normalX;
+		}
+		const AlignedFloats & getNormalY() const {
+			return m_normalY;
+		}
+		const AlignedFloats & getNormalZ() const {
+			return m_normalZ;
+		}
+		const AlignedFloats & getExpansionX() const {
+			return m_expansionX;
+		}
+		const AlignedFloats & getExpansionY() const {
+			return m_expansionY;
+		}
+		const AlignedFloats & getExpansionZ() const {
+			return m_expansionZ;
+		}
+
+		// triangles, 3 indices each, in getCompactIndices() instead for a compact mesh
+		const std::vector<IndexType> & getIndices() const {
+			return m_indices;
+		}
+		// triangles of a compact mesh, empty otherwise
+		const std::vector<CompactIndexType> & getCompactIndices() const {
+			return m_compactIndices;
+		}
+
+		// hard constraints, widened to IndexType whatever they are stored with, e.g. to draw them
+		IndexType getConstraintCount() const;
+		void getConstraints(std::vector<IndexType> & a, std::vector<IndexType> & b, std::vector<float> & distances) const;
+
+		// constraints and triangles stored with CompactIndexType, picked when the graph is, see PatternGraph
+		bool isCompact() const {
+			return m_bCompact;
+		}
+
 	private:
 		struct Properties
 		{
 			bool isFix;
 		};
 
-		void addTriangle(ofIndexType tri0, ofIndexType tri1, ofIndexType tri2);
-		void setDistanceConstrain(ofIndexType a, ofIndexType b, float distance);
-		void setAngleConstrain(ofIndexType a, ofIndexType b, float degrees);
+		template <typename Index>
+		struct Constraints
+		{
+			BasicConstraints<Index> hard;
+			BasicConstraints<Index> soft; // only pull when longer than their distance
+		};
+
+		// calls function with the constraints in use, compact or wide
+		template <typename Function>
+		void withConstraints(Function function) {
+			if (m_bCompact) function(m_compactCon);
+			else function(m_con);
+		}
+		template <typename Function>
+		void withConstraints(Function function) const {
+			if (m_bCompact) function(m_compactCon);
+			else function(m_con);
+		}
+
+		// calls function with the triangles in use, compact or wide
+		template <typename Function>
+		void withIndices(Function function) {
+			if (m_bCompact) function(m_compactIndices);
+			else function(m_indices);
+		}
+		template <typename Function>
+		void withIndices(Function function) const {
+			if (m_bCompact) function(m_compactIndices);
+			else function(m_indices);
+		}
+
+		void addTriangle(IndexType tri0, IndexType tri1, IndexType tri2);
+		void setDistanceConstrain(IndexType a, IndexType b, float distance);
+		void setAngleConstrain(IndexType a, IndexType b, float degrees);
 		void solveConstraints();
+		template <typename Index>
+		void solveColors(const BasicConstraints<Index> & constraints, bool bStretchOnly);
 		void computeForces();
 		void verletUpdate(float deltaTime);
 		void updateCenter();
-		void updateNormals();
+		void parallelFor(IndexType begin, IndexType end, unsigned int minChunk, const ThreadPool::RangeFunction & function);
+
+		float m_centerX;
+		float m_centerY;
+		float m_centerZ;
 
-		ofMesh m_mesh;
+		std::map <IndexType, Properties> m_properties;
+		// only the constraints and triangles of the width of the graph are filled
+		// 16 bit vertices halve the index buffers every solver pass streams through
+		bool m_bCompact = false;
+		Constraints<IndexType> m_con;
+		Constraints<CompactIndexType> m_compactCon;
 
-		glm::vec3 m_center;
+		// simulation state, as structure of arrays for the constraint kernels
+		AlignedFloats m_x;
+		AlignedFloats m_y;
+		AlignedFloats m_z;
+		AlignedFloats m_oldX;
+		AlignedFloats m_oldY;
+		AlignedFloats m_oldZ;
+		AlignedFloats m_normalX;
+		AlignedFloats m_normalY;
+		AlignedFloats m_normalZ;
+		AlignedFloats m_expansionX;
+		AlignedFloats m_expansionY;
+		AlignedFloats m_expansionZ;
 
-		std::map <ofIndexType, glm::vec3> m_expansionForce;
-		std::map <ofIndexType, Properties> m_properties;
-		std::map <ofIndexType, std::set<std::pair<ofIndexType, float>>> m_con;
-		std::map <ofIndexType, std::set<std::pair<ofIndexType, float>>> m_soft_con;
+		// triangles, 3 indices each
+		std::vector<IndexType> m_indices;
+		std::vector<CompactIndexType> m_compactIndices;
+		// faces around vertex v are [m_vertexFaceOffsets[v], m_vertexFaceOffsets[v + 1]) in m_vertexFaces
+		// they count faces and corners, about 2 and 6 per vertex, so they stay IndexType in a compact mesh
+		std::vector<IndexType> m_vertexFaceOffsets;
+		std::vector<IndexType> m_vertexFaces;
 
-		std::vector<glm::vec3> m_oldVec;
+		std::shared_ptr<ThreadPool> m_pool;
 
 		unsigned int m_roundNum;
 		float m_pointDistance;
 		float m_minTension;
 		float m_damping;
+		float m_expansion;
 		unsigned int m_solveIterations;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "Operation.h"
+
+namespace ami
+{
+	// One round of a pattern, run length encoded: groups of (operation, count) runs, each group repeated
+	// e.g. 6 x [SC x 4, INC] is one group of two runs, 30 stitches in 2 runs
+	// Memory follows the written pattern, not the stitch count, flat operations are only produced by the iterator
+	class PatternRound
+	{
+	public:
+		struct Group
+		{
+			unsigned int begin; // runs [begin, end)
+			unsigned int end;
+			unsigned int repeat;
+		};
+
+		// walks the operations one by one, expanding counts and repeats
+		class const_iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef Operation::Type value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const Operation::Type * pointer;
+			typedef const Operation::Type & reference;
+
+			const_iterator() : m_round(nullptr), m_group(0), m_repeat(0), m_run(0), m_count(0) {}
+			const_iterator(const PatternRound & round, unsigned int group)
+				: m_round(&round), m_group(group), m_repeat(0), m_run(0), m_count(0)
+			{
+				if (m_group < m_round->m_groups.size()) m_run = m_round->m_groups[m_group].begin;
+			}
+
+			reference operator*() const {
+				return m_round->m_runs[m_run].type;
+			}
+
+			const_iterator & operator++()
+			{
+				if (++m_count < m_round->m_runs[m_run].count) return *this;
+				m_count = 0;
+
+				const Group & group = m_round->m_groups[m_group];
+				if (++m_run < group.end) return *this;
+				m_run = group.begin;
+
+				if (++m_repeat < group.repeat) return *this;
+				m_repeat = 0;
+
+				if (++m_group < m_round->m_groups.size()) m_run = m_round->m_groups[m_group].begin;
+				return *this;
+			}
+
+			const_iterator operator++(int)
+			{
+				const_iterator previous = *this;
+				++(*this);
+				return previous;
+			}
+
+			bool operator==(const const_iterator & other) const
+			{
+				return m_group == other.m_group && m_repeat == other.m_repeat && m_run == other.m_run && m_count == other.m_count;
+			}
+
+			bool operator!=(const const_iterator & other) const {
+				return !(*this == other);
+			}
+
+		private:
+			const PatternRound * m_round;
+			unsigned int m_group;
+			unsigned int m_repeat;
+			unsigned int m_run;
+			unsigned int m_count;
+		};
+
+		PatternRound() : m_size(0) {}
+
+		// compresses a flat list of operations into runs
+		explicit PatternRound(const Operation::Operations & operations) : m_size(0)
+		{
+			for (Operation::Type type : operations)
+			{
+				this->add(type);
+			}
+		}
+
+		// appends count operations, merged with the last run when it is the same operation
+		void add(Operation::Type type, unsigned int count = 1)
+		{
+			this->add(Operation::Run(type, count));
+		}
+
+		void add(const Operation::Run & run)
+		{
+			if (run.count == 0) return;
+
+			if (m_groups.empty() || m_groups.back().repeat != 1)
+			{
+				Group group = { (unsigned int)m_runs.size(), (unsigned int)m_runs.size(), 1 };
+				m_groups.push_back(group);
+			}
+
+			// the last group always ends at m_runs.size(), so it has runs when m_runs grew past its begin
+			Group & group = m_groups.back();
+			if (m_runs.size() > group.begin && m_runs.back().type == run.type)
+			{
+				m_runs.back().count += run.count;
+			}
+			else
+			{
+				m_runs.push_back(run);
+				group.end++;
+			}
+			m_size += run.count;
+		}
+
+		// appends runs repeated repeat times, e.g. addGroup({ {SC, 4}, {INC, 1} }, 6)
+		void addGroup(const std::vector<Operation::Run> & runs, unsigned int repeat)
+		{
+			if (repeat == 1)
+			{
+				for (auto & run : runs) this->add(run);
+				return;
+			}
+
+			Group group = { (unsigned int)m_runs.size(), (unsigned int)m_runs.size(), repeat };
+			std::size_t stitches = 0;
+			for (auto & run : runs)
+			{
+				if (run.count == 0) continue;
+				if (m_runs.size() > group.begin && m_runs.back().type == run.type)
+				{
+					m_runs.back().count += run.count;
+				}
+				else
+				{
+					m_runs.push_back(run);
+					group.end++;
+				}
+				stitches += run.count;
+			}
+			if (group.end == group.begin || repeat == 0)
+			{
+				m_runs.resize(group.begin);
+				return;
+			}
+
+			m_groups.push_back(group);
+			m_size += stitches * repeat;
+		}
+
+		// calls function(run) for every run in order, repeats included, without expanding counts
+		template <class Function>
+		void forEachRun(Function function) const
+		{
+			for (auto & group : m_groups)
+			{
+				for (unsigned int repeat = 0; repeat < group.repeat; repeat++)
+				{
+					for (unsigned int run = group.begin; run < group.end; run++)
+					{
+						function(m_runs[run]);
+					}
+				}
+			}
+		}
+
+		// operations in the round, counts and repeats expanded
+		std::size_t size() const {
+			return m_size;
+		}
+
+		bool empty() const {
+			return m_size == 0;
+		}
+
+		const std::vector<Operation::Run> & getRuns() const {
+			return m_runs;
+		}
+
+		const std::vector<Group> & getGroups() const {
+			return m_groups;
+		}
+
+		const_iterator begin() const {
+			return const_iterator(*this, 0);
+		}
+
+		const_iterator end() const {
+			return const_iterator(*this, (unsigned int)m_groups.size());
+		}
+
+		// same operations in the same order, however they are grouped
+		bool operator==(const PatternRound & other) const
+		{
+			if (m_size != other.m_size) return false;
+
+			const_iterator op = this->begin();
+			const_iterator otherOp = other.begin();
+			for (; op != this->end(); ++op, ++otherOp)
+			{
+				if (*op != *otherOp) return false;
+			}
+			return true;
+		}
+
+		bool operator!=(const PatternRound & other) const {
+			return !(*this == other);
+		}
+
+	private:
+		std::vector<Operation::Run> m_runs;
+		std::vector<Group> m_groups;
+		std::size_t m_size;
+	};
+}
@@ -0,0 +1,194 @@
+#include "PatternSimulation.h"
+
+namespace ami
+{
+	PatternSimulation::PatternSimulation(float deltaTime)
+		:
+		m_deltaTime(deltaTime),
+		m_period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(deltaTime))),
+		m_bRunning(false),
+		m_waiting(0)
+	{
+		m_thread = std::thread(&PatternSimulation::run, this);
+	}
+
+	PatternSimulation::~PatternSimulation()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_wake.notify_all();
+		m_thread.join();
+	}
+
+	void PatternSimulation::setStepFunction(const StepFunction & function)
+	{
+		{
+			std::unique_lock<std::mutex> meshLock = this->lockOutside();
+			m_stepFunction = function;
+		}
+		this->leaveOutside(false);
+	}
+
+	void PatternSimulation::access(const MeshFunction & function)
+	{
+		{
+			std::unique_lock<std::mutex> meshLock = this->lockOutside();
+			function(m_mesh);
+			m_topology.reset();
+		}
+		this->leaveOutside(true);
+	}
+
+	void PatternSimulation::post(MeshFunction function)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			std::swap(m_posted, function);
+		}
+		m_wake.notify_all();
+		// a function dropped here is destroyed without the lock, with whatever it holds
+	}
+
+	void PatternSimulation::setRunning(bool bRunning)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (bRunning && !m_bRunning) m_next = Clock::now(); // no steps to catch up on from the pause
+			m_bRunning = bRunning;
+		}
+		m_wake.notify_all();
+	}
+
+	bool PatternSimulation::isRunning() const
+	{
+		return m_bRunning;
+	}
+
+	void PatternSimulation::step()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requestedSteps++;
+		}
+		m_wake.notify_all();
+	}
+
+	std::unique_lock<std::mutex> PatternSimulation::lockOutside()
+	{
+		m_waiting++;
+		std::unique_lock<std::mutex> meshLock(m_meshMutex);
+		m_waiting--;
+		return meshLock;
+	}
+
+	void PatternSimulation::leaveOutside(bool bPublish)
+	{
+		// m_waiting dropped without m_mutex, taking it here makes sure the simulation sees that before it waits again
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (bPublish) m_bPublish = true;
+		}
+		m_wake.notify_all();
+	}
+
+	void PatternSimulation::run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			// threads waiting for the mesh go first, the simulation only works once they are done
+			auto bReady = [this] {
+				return m_bStop || (m_waiting == 0 && (m_posted || m_requestedSteps > 0 || m_bPublish || (m_bRunning && Clock::now() >= m_next)));
+			};
+			// a waiting thread lowers m_waiting without m_mutex, and notifies with it once it is done
+			// waiting until a step already due would spin and keep it out
+			if (m_bRunning && m_waiting == 0)
+			{
+				m_wake.wait_until(lock, m_next, bReady);
+			}
+			else
+			{
+				m_wake.wait(lock, bReady);
+			}
+			if (m_bStop) return;
+			if (!bReady()) continue; // woke up for the next step as another thread came in
+
+			MeshFunction posted = std::move(m_posted);
+			m_posted = nullptr;
+			bool bStep = false;
+			bool bTimed = false;
+			if (m_requestedSteps > 0)
+			{
+				m_requestedSteps--;
+				bStep = true;
+			}
+			else if (m_bRunning && Clock::now() >= m_next)
+			{
+				bStep = true;
+				bTimed = true;
+			}
+			m_bPublish = false;
+
+			// the mesh is worked on without m_mutex, so requests come in without waiting for the step
+			lock.unlock();
+			{
+				std::lock_guard<std::mutex> meshLock(m_meshMutex);
+				if (posted)
+				{
+					posted(m_mesh);
+					m_topology.reset();
+				}
+				if (bStep) this->stepLocked();
+				this->publishLocked();
+			}
+			lock.lock();
+
+			if (bTimed)
+			{
+				// a step slower than the period delays the following ones, it does not make them run back to back
+				m_next += m_period;
+				Clock::time_point now = Clock::now();
+				if (m_next < now) m_next = now;
+			}
+		}
+	}
+
+	void PatternSimulation::stepLocked()
+	{
+		// nothing to step before a pattern is installed, e.g. after a failed setPattern
+		if (m_mesh.getVertexCount() == 0) return;
+
+		m_mesh.update(m_deltaTime);
+		m_steps++;
+		if (m_stepFunction) m_stepFunction(m_mesh, m_deltaTime);
+	}
+
+	void PatternSimulation::publishLocked()
+	{
+		if (!m_topology)
+		{
+			std::shared_ptr<Topology> topology(new Topology());
+			topology->indices = m_mesh.getIndices();
+			topology->compactIndices = m_mesh.getCompactIndices();
+			m_mesh.getConstraints(topology->constraintA, topology->constraintB, topology->constraintDistances);
+			m_topology = topology;
+		}
+
+		// assigning keeps the capacity of the slot, copies allocate only when the mesh grows
+		Snapshot & snapshot = m_snapshots.getWriteBuffer();
+		snapshot.x = m_mesh.getX();
+		snapshot.y = m_mesh.getY();
+		snapshot.z = m_mesh.getZ();
+		snapshot.normalX = m_mesh.getNormalX();
+		snapshot.normalY = m_mesh.getNormalY();
+		snapshot.normalZ = m_mesh.getNormalZ();
+		snapshot.expansionX = m_mesh.getExpansionX();
+		snapshot.expansionY = m_mesh.getExpansionY();
+		snapshot.expansionZ = m_mesh.getExpansionZ();
+		snapshot.topology = m_topology;
+		snapshot.steps = m_steps;
+		m_snapshots.publish();
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "PatternMesh.h"
+#include "TripleBuffer.h"
+#include "Types.h"
+
+namespace ami
+{
+	// Steps a PatternMesh on its own thread at a fixed rate and publishes a copy of its vertices after every step
+	// The render thread reads the last copy through a TripleBuffer, it never waits for a step
+	// access() and setStepFunction() wait for the step in progress, if any, the other calls never do
+	class PatternSimulation
+	{
+	public:
+		// what does not change between steps, shared by all the snapshots of one mesh
+		struct Topology
+		{
+			// triangles in the width of the mesh, only one of them is filled, see PatternMesh::getIndices()
+			std::vector<IndexType> indices;
+			std::vector<CompactIndexType> compactIndices;
+			// hard constraints, widened to IndexType
+			std::vector<IndexType> constraintA;
+			std::vector<IndexType> constraintB;
+			std::vector<float> constraintDistances;
+		};
+
+		struct Snapshot
+		{
+			AlignedFloats x, y, z;
+			AlignedFloats normalX, normalY, normalZ;
+			AlignedFloats expansionX, expansionY, expansionZ;
+			std::shared_ptr<const Topology> topology;
+			std::uint64_t steps = 0; // steps taken by the simulation when it was published
+
+			IndexType getVertexCount() const {
+				return x.size();
+			}
+		};
+
+		// called on the simulation thread after every step, with the mesh locked
+		typedef std::function<void(PatternMesh & mesh, float deltaTime)> StepFunction;
+		// called on the simulation thread with the mesh locked, may replace the mesh
+		typedef std::function<void(PatternMesh & mesh)> MeshFunction;
+
+		// starts paused, with an empty mesh
+		PatternSimulation(float deltaTime = 0.016f);
+		~PatternSimulation();
+
+		PatternSimulation(const PatternSimulation &) = delete;
+		PatternSimulation & operator=(const PatternSimulation &) = delete;
+
+		void setStepFunction(const StepFunction & function);
+
+		// runs function with the mesh between two steps, on the calling thread, the simulation waits for it
+		// it may replace the mesh, a snapshot of the mesh it leaves is published right after
+		void access(const MeshFunction & function);
+
+		// hands function to the simulation thread, which runs it before its next step, the caller never waits
+		// a function posted before and not run yet is dropped, a snapshot is published right after it runs
+		void post(MeshFunction function);
+
+		void setRunning(bool bRunning);
+		bool isRunning() const;
+
+		// one more step, taken as soon as the simulation thread can, meant for a paused simulation
+		void step();
+
+		// render thread: takes the last snapshot published, false if there is no newer one
+		bool updateSnapshot() {
+			return m_snapshots.update();
+		}
+		// render thread: the snapshot taken by the last updateSnapshot()
+		const Snapshot & getSnapshot() const {
+			return m_snapshots.getReadBuffer();
+		}
+
+		float getDeltaTime() const {
+			return m_deltaTime;
+		}
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		void run();
+		// locks m_meshMutex from another thread, the simulation lets it in before its next step
+		std::unique_lock<std::mutex> lockOutside();
+		// wakes the simulation once the mesh locked by lockOutside() is released, with bPublish it publishes a snapshot
+		void leaveOutside(bool bPublish);
+		// with m_meshMutex locked, on the simulation thread
+		void stepLocked();
+		void publishLocked();
+
+		const float m_deltaTime;
+		const Clock::duration m_period;
+
+		// requests to the simulation thread, m_mutex is never held for a step, so setting them does not wait
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		MeshFunction m_posted;
+		Clock::time_point m_next; // time of the next step while running
+		unsigned int m_requestedSteps = 0;
+		bool m_bPublish = false;
+		std::atomic<bool> m_bRunning; // written with m_mutex locked
+		bool m_bStop = false;
+		// threads waiting for m_meshMutex, the simulation lets them in before its next step
+		std::atomic<unsigned int> m_waiting;
+
+		// the mesh and the step function only change with m_meshMutex locked, the thread holds it for a whole step
+		std::mutex m_meshMutex;
+		PatternMesh m_mesh;
+		StepFunction m_stepFunction;
+		std::shared_ptr<const Topology> m_topology; // null once the mesh may have been replaced
+		std::uint64_t m_steps = 0;
+
+		// only the simulation thread publishes
+		TripleBuffer<Snapshot> m_snapshots;
+
+		std::thread m_thread;
+	};
+}
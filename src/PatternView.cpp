@@ -1,16 +1,122 @@
 #include "PatternView.h"
 
+#include "ofGraphics.h"
+
 namespace ami
 {
 	PatternView::PatternView()
-	{}
+		:
+		m_threadCount(1),
+		m_bStorePending(false),
+		m_pendingKey(0),
+		m_pendingSteps(0),
+		m_simulation(m_solver.deltaTime)
+	{
+		m_simulation.setStepFunction([this](PatternMesh & mesh, float deltaTime)
+		{
+			this->onStep(mesh, deltaTime);
+		});
+	}
 
 	void PatternView::render()
 	{
-		m_mesh.draw();
+		if (m_simulation.updateSnapshot())
+		{
+			this->updateMesh();
+		}
+		const PatternSimulation::Snapshot & snapshot = m_simulation.getSnapshot();
+		if (!snapshot.topology) return; // nothing published yet
+
+		ofPushStyle();
+		ofDisableDepthTest();
+		ofEnableBlendMode(ofBlendMode::OF_BLENDMODE_ALPHA);
+		ofSetColor(255);
+		glPointSize(5.0f);
+		m_renderMesh.drawVertices();
+		//ofSetColor(200, 50);
+		//m_renderMesh.draw();
+		ofSetColor(200);
+		m_renderMesh.drawWireframe();
+
+		ofSetColor(ofColor::green);
+		for (ofIndexType v = 0; v < snapshot.getVertexCount(); v++)
+		{
+			glm::vec3 expansion(snapshot.expansionX[v], snapshot.expansionY[v], snapshot.expansionZ[v]);
+			if (expansion == glm::vec3(0.0f)) continue;
+
+			glm::vec3 start = m_renderMesh.getVertex(v);
+			glm::vec3 end = start + glm::normalize(expansion);
+			glBegin(GL_LINES);
+			glVertex3f(start.x, start.y, start.z);
+			glVertex3f(end.x, end.y, end.z);
+			glEnd();
+		}
+
+		ofSetLineWidth(2.0f);
+		ofSetColor(ofColor::red);
+		const PatternSimulation::Topology & topology = *snapshot.topology;
+		for (ofIndexType c = 0; c < topology.constraintA.size(); c++)
+		{
+			glm::vec3 & point0 = m_renderMesh.getVertices()[topology.constraintA[c]];
+			glm::vec3 & point1 = m_renderMesh.getVertices()[topology.constraintB[c]];
+
+			glm::vec3 start = point0;
+			glm::vec3 end = point0 + glm::normalize(point1 - point0) * topology.constraintDistances[c]; // show the correct distance
+
+			glBegin(GL_LINES);
+			glVertex3f(start.x, start.y, start.z);
+			glVertex3f(end.x, end.y, end.z);
+			glEnd();
+		}
+
+		ofPopStyle();
 	}
 
-	void PatternView::update(float deltaTime)
+	void PatternView::updateMesh()
+	{
+		const PatternSimulation::Snapshot & snapshot = m_simulation.getSnapshot();
+
+		// the indices are only copied when the simulation gets another mesh
+		if (snapshot.topology != m_renderTopology)
+		{
+			m_renderTopology = snapshot.topology;
+			m_renderMesh.clear();
+			m_renderMesh.getVertices().resize(snapshot.getVertexCount());
+			m_renderMesh.getNormals().resize(snapshot.getVertexCount());
+			if (m_renderTopology)
+			{
+				m_renderMesh.addIndices(m_renderTopology->indices.data(), m_renderTopology->indices.size());
+				// the indices of a compact mesh are only widened here, for ofMesh
+				const std::vector<CompactIndexType> & compactIndices = m_renderTopology->compactIndices;
+				m_renderMesh.getIndices().insert(m_renderMesh.getIndices().end(), compactIndices.begin(), compactIndices.end());
+			}
+		}
+
+		std::vector<glm::vec3> & vertices = m_renderMesh.getVertices();
+		std::vector<glm::vec3> & normals = m_renderMesh.getNormals();
+		for (ofIndexType v = 0; v < snapshot.getVertexCount(); v++)
+		{
+			vertices[v] = glm::vec3(snapshot.x[v], snapshot.y[v], snapshot.z[v]);
+			normals[v] = glm::vec3(snapshot.normalX[v], snapshot.normalY[v], snapshot.normalZ[v]);
+		}
+	}
+
+	void PatternView::setRunning(bool bRunning)
+	{
+		m_simulation.setRunning(bRunning);
+	}
+
+	bool PatternView::isRunning() const
+	{
+		return m_simulation.isRunning();
+	}
+
+	void PatternView::step()
+	{
+		m_simulation.step();
+	}
+
+	void PatternView::onStep(PatternMesh & mesh, float deltaTime)
 	{
 		//if (m_sbs.bStep) // are we doing step by step?
 		//{
@@ -25,16 +131,49 @@ namespace ami
 		//	}
 		//}
 
-		m_mesh.update(deltaTime);
+		if (m_bStorePending)
+		{
+			m_pendingSteps++;
+			if (deltaTime != m_solver.deltaTime || m_pendingSteps > m_solver.maxSteps)
+			{
+				m_bStorePending = false; // not relaxed as the key says
+			}
+			else if (mesh.getMaxDeformation() < m_solver.tolerance)
+			{
+				m_cache.store(m_pendingKey, *m_simGraph, mesh);
+				m_bStorePending = false;
+			}
+		}
+	}
+
+	void PatternView::setCache(const std::string & directory)
+	{
+		m_simulation.access([&](PatternMesh &)
+		{
+			m_cache = PatternCache(directory);
+		});
+	}
+
+	void PatternView::setThreadCount(unsigned int threads)
+	{
+		m_threadCount = threads;
+		m_simulation.access([&](PatternMesh & mesh)
+		{
+			mesh.setThreadCount(threads);
+		});
 	}
 
 	void PatternView::setPattern(const PatternDef & pattern, bool bStep)
 	{
 		m_sbs.bStep = bStep;
 
-		PatternGraph graph(pattern);
-
-		m_mesh = PatternMesh(graph);
+		std::uint64_t key = PatternCache::getKey(pattern, m_solver);
+		if (!this->loadCached(pattern, key))
+		{
+			std::shared_ptr<const PatternGraph> graph(new PatternGraph(pattern));
+			PatternMesh mesh(*graph, m_solver.parameters);
+			this->setMesh(pattern, graph, std::move(mesh), false, true, key);
+		}
 
 		//if (bStep) // setup the step by step
 		//{
@@ -51,4 +190,61 @@ namespace ami
 		//	}
 		//}
 	}
-}
\ No newline at end of file
+
+	void PatternView::applyLoaded(PatternLoader::Result & loaded, bool bKeepShared)
+	{
+		if (!loaded.graph) return;
+
+		unsigned int firstChanged = bKeepShared ? m_pattern.getSharedRounds(loaded.pattern) : 0;
+		if (bKeepShared && m_graph && firstChanged == m_pattern.getRounds().size() && firstChanged == loaded.pattern.getRounds().size()) return; // nothing changed
+
+		// the graph and mesh were built by the loader, a cached mesh is already relaxed and keeps nothing
+		this->setMesh(std::move(loaded.pattern), std::move(loaded.graph), std::move(loaded.mesh), bKeepShared && !loaded.bCached, !loaded.bCached, loaded.key);
+	}
+
+	std::unique_ptr<PatternLoader::Previous> PatternView::getPrevious() const
+	{
+		// m_graph is only used on the main thread, the simulation keeps its own pointer to the graph it runs
+		if (!m_graph) return nullptr;
+		return std::unique_ptr<PatternLoader::Previous>(new PatternLoader::Previous{ m_pattern, m_graph });
+	}
+
+	bool PatternView::loadCached(const PatternDef & pattern, std::uint64_t key)
+	{
+		PatternCache::Entry entry;
+		if (!m_cache.load(key, m_solver, entry)) return false;
+
+		this->setMesh(pattern, std::move(entry.graph), std::move(entry.mesh), false, false, key);
+		return true;
+	}
+
+	void PatternView::setMesh(PatternDef pattern, std::shared_ptr<const PatternGraph> graph, PatternMesh mesh, bool bKeepShared, bool bStore, std::uint64_t key)
+	{
+		m_pattern = pattern;
+		m_graph = graph;
+
+		// swapped in and warm started on the simulation thread between two steps, a mesh not swapped in yet is dropped,
+		// so the kept rounds are found against the mesh actually simulated
+		// the render mesh follows once the snapshot of the new mesh is published
+		m_simulation.post([this, pattern = std::move(pattern), graph, mesh = std::move(mesh), bKeepShared, bStore, key](PatternMesh & current) mutable
+		{
+			IndexType keptVertices = 0;
+			if (bKeepShared && m_simGraph)
+			{
+				unsigned int firstChanged = m_simPattern.getSharedRounds(pattern);
+				if (firstChanged > 0) keptVertices = graph->getNodeCount(firstChanged);
+			}
+
+			mesh.setThreadCount(m_threadCount);
+			if (keptVertices > 0) mesh.warmStart(current, keptVertices, *graph);
+			current = std::move(mesh);
+			m_simPattern = std::move(pattern);
+			m_simGraph = std::move(graph);
+
+			// only shapes relaxed from scratch are cached
+			m_bStorePending = bStore && keptVertices == 0;
+			m_pendingKey = key;
+			m_pendingSteps = 0;
+		});
+	}
+}
@@ -1,24 +1,70 @@
 #pragma once
 
+#include "ofMesh.h"
+#include "PatternCache.h"
 #include "PatternDef.h"
+#include "PatternLoader.h"
 #include "PatternMesh.h"
+#include "PatternSimulation.h"
+
+#include <atomic>
+#include <memory>
 
 namespace ami
 {
+	// openFrameworks client of the simulation: owns the render mesh and draws it
+	// The simulation steps on its own thread, render() draws the last snapshot it published
 	class PatternView
 	{
 	public:
 		PatternView();
 
+		// a pattern relaxed before is loaded from the cache already settled,
+		// others are relaxed live and stored once they settle
 		void setPattern(const PatternDef & pattern, bool bStep = false);
 
+		// hands a pattern loaded in the background to the simulation, which swaps it in between two steps, never waits
+		// with bKeepShared the rounds it shares with the current pattern keep their positions,
+		// the rest relaxes from there instead of from the spiral, otherwise it starts over as in setPattern
+		void applyLoaded(PatternLoader::Result & loaded, bool bKeepShared = true);
+
+		// the pattern shown and its graph, for a reload to rebuild only the changed rounds
+		// the graph is shared, not copied, the loader copies it on its own thread
+		// null before the first pattern
+		std::unique_ptr<PatternLoader::Previous> getPrevious() const;
+
+		// directory of relaxed meshes, empty disables it
+		void setCache(const std::string & directory);
+
+		const PatternCache & getCache() const {
+			return m_cache;
+		}
+
+		const PatternCache::Solver & getSolver() const {
+			return m_solver;
+		}
+
+		// draws the last snapshot of the simulation, never waits for a step
 		void render();
 
-		void update(float deltaTime);
+		// the simulation starts paused
+		void setRunning(bool bRunning);
+		bool isRunning() const;
 
-		PatternMesh m_mesh;
+		// one step of a paused simulation
+		void step();
+
+		void setThreadCount(unsigned int threads);
 
 	private:
+		// copies the snapshot into the render mesh
+		void updateMesh();
+
+		// render copy of the simulation, only written when drawing
+		ofMesh m_renderMesh;
+		// topology the indices of m_renderMesh were copied from
+		std::shared_ptr<const PatternSimulation::Topology> m_renderTopology;
+
 		struct StepByStep
 		{
 			bool bStep;
@@ -27,5 +73,35 @@ namespace ami
 			float lastMillis;
 			float stepPeriod;
 		} m_sbs;
+
+		// also read on the simulation thread, when it swaps a mesh in
+		std::atomic<unsigned int> m_threadCount;
+
+		// loads a relaxed mesh of pattern, false if it is not cached
+		bool loadCached(const PatternDef & pattern, std::uint64_t key);
+		// hands mesh to the simulation thread, which swaps it in before its next step, the caller never waits
+		// with bKeepShared the rounds pattern shares with the simulated pattern keep their positions
+		// with bStore a mesh relaxed from the spiral is stored with key once it settles
+		void setMesh(PatternDef pattern, std::shared_ptr<const PatternGraph> graph, PatternMesh mesh, bool bKeepShared, bool bStore, std::uint64_t key);
+		// on the simulation thread after every step
+		void onStep(PatternMesh & mesh, float deltaTime);
+
+		// what was last handed to the simulation, to diff reloads against, only used on the main thread
+		PatternDef m_pattern;
+		std::shared_ptr<const PatternGraph> m_graph; // shared with the loader and the simulation, never modified
+
+		PatternCache m_cache;
+		PatternCache::Solver m_solver;
+
+		// what the simulated mesh was built from, only used on the simulation thread
+		PatternDef m_simPattern;
+		std::shared_ptr<const PatternGraph> m_simGraph;
+		// a mesh relaxed from the spiral is stored once it settles
+		bool m_bStorePending;
+		std::uint64_t m_pendingKey;
+		unsigned int m_pendingSteps;
+
+		// last, so its thread stops before the members onStep uses are destroyed
+		PatternSimulation m_simulation;
 	};
 }
\ No newline at end of file
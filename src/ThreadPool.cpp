@@ -0,0 +1,153 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace ami
+{
+	ThreadPool::ThreadPool(unsigned int threadCount)
+		:
+		m_shares(std::max(threadCount, 1u))
+	{
+		for (unsigned int i = 1; i < threadCount; i++)
+		{
+			m_workers.emplace_back(&ThreadPool::work, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStop = true;
+		}
+		m_start.notify_all();
+
+		for (auto & worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::parallelFor(unsigned int begin, unsigned int end, unsigned int minChunk, const RangeFunction & function)
+	{
+		if (begin >= end) return;
+
+		unsigned int threads = getThreadCount();
+		if (threads == 1 || end - begin < minChunk * 2)
+		{
+			function(begin, end);
+			return;
+		}
+
+		threads = std::min(threads, (end - begin) / std::max(minChunk, 1u));
+		unsigned int chunk = (end - begin + threads - 1) / threads;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_function = &function;
+			m_begin = begin;
+			m_chunk = chunk;
+			m_end = end;
+			m_pending = m_workers.size();
+			m_bSteal = false;
+			m_generation++;
+		}
+		m_start.notify_all();
+
+		// the calling thread takes the first chunk
+		function(begin, std::min(begin + chunk, end));
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_pending == 0; });
+		m_function = nullptr;
+	}
+
+	void ThreadPool::parallelForEach(unsigned int begin, unsigned int end, unsigned int grain, const RangeFunction & function)
+	{
+		if (begin >= end) return;
+
+		grain = std::max(grain, 1u);
+		unsigned int threads = getThreadCount();
+		if (threads == 1 || end - begin <= grain)
+		{
+			function(begin, end);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			unsigned int chunk = (end - begin + threads - 1) / threads;
+			for (unsigned int i = 0; i < threads; i++)
+			{
+				m_shares[i].next = std::min(begin + chunk * i, end);
+				m_shares[i].end = std::min(begin + chunk * (i + 1), end);
+			}
+			m_function = &function;
+			m_grain = grain;
+			m_pending = m_workers.size();
+			m_bSteal = true;
+			m_generation++;
+		}
+		m_start.notify_all();
+
+		steal(0);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_pending == 0; });
+		m_function = nullptr;
+	}
+
+	void ThreadPool::steal(unsigned int threadIndex)
+	{
+		unsigned int threads = getThreadCount();
+		for (unsigned int i = 0; i < threads; i++)
+		{
+			Share & share = m_shares[(threadIndex + i) % threads];
+			while (true)
+			{
+				// claims past the end are harmless, the share is done
+				unsigned int begin = share.next.fetch_add(m_grain);
+				if (begin >= share.end) break;
+				(*m_function)(begin, std::min(begin + m_grain, share.end));
+			}
+		}
+	}
+
+	void ThreadPool::work(unsigned int workerIndex)
+	{
+		unsigned int generation = 0;
+		while (true)
+		{
+			const RangeFunction * function;
+			unsigned int begin;
+			unsigned int end;
+			bool bSteal;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_start.wait(lock, [this, generation] { return m_bStop || m_generation != generation; });
+				if (m_bStop) return;
+
+				generation = m_generation;
+				function = m_function;
+				bSteal = m_bSteal;
+				begin = std::min(m_begin + m_chunk * workerIndex, m_end);
+				end = std::min(begin + m_chunk, m_end);
+			}
+
+			if (bSteal)
+			{
+				steal(workerIndex);
+			}
+			else if (begin < end)
+			{
+				(*function)(begin, end);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pending--;
+			}
+			m_done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "AlignedAllocator.h"
+
+namespace ami
+{
+	// Fixed set of worker threads running fork-join loops
+	// The calling thread takes part in the work, so a pool of 1 thread has no workers
+	class ThreadPool
+	{
+	public:
+		typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunction;
+
+		ThreadPool(unsigned int threadCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool & operator=(const ThreadPool &) = delete;
+
+		unsigned int getThreadCount() const {
+			return m_workers.size() + 1;
+		}
+
+		// split [begin, end) in one contiguous chunk per thread and wait for all of them
+		// ranges smaller than minChunk per thread are not worth waking the workers and run inline
+		void parallelFor(unsigned int begin, unsigned int end, unsigned int minChunk, const RangeFunction & function);
+
+		// for items of uneven cost: each thread starts on its own contiguous share of [begin, end), taking grain items at a time,
+		// and steals grains from the shares of the other threads once its own is done, then waits for all of them
+		void parallelForEach(unsigned int begin, unsigned int end, unsigned int grain, const RangeFunction & function);
+
+	private:
+		// next unclaimed item and end of the share of one thread, a cache line each so claims do not contend
+		struct alignas(64) Share
+		{
+			std::atomic<unsigned int> next;
+			unsigned int end;
+		};
+
+		void work(unsigned int workerIndex);
+		// claims grains from the share of threadIndex, then from the others
+		void steal(unsigned int threadIndex);
+
+		std::vector<std::thread> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_start;
+		std::condition_variable m_done;
+
+		const RangeFunction * m_function = nullptr;
+		unsigned int m_begin = 0;
+		unsigned int m_chunk = 0;
+		unsigned int m_end = 0;
+		unsigned int m_generation = 0;
+		unsigned int m_pending = 0;
+		bool m_bStop = false;
+
+		// parallelForEach state
+		bool m_bSteal = false;
+		unsigned int m_grain = 1;
+		std::vector<Share, AlignedAllocator<Share>> m_shares;
+	};
+}
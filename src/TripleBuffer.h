@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+
+namespace ami
+{
+	// Hands the latest value from one writer thread to one reader thread without locks
+	// Each side owns a slot, the third is swapped between them: the writer never waits for the reader
+	// and the reader always gets the last value published, values published in between are skipped
+	template <typename T>
+	class TripleBuffer
+	{
+	public:
+		TripleBuffer()
+			:
+			m_middle(1),
+			m_write(0),
+			m_read(2)
+		{}
+
+		TripleBuffer(const TripleBuffer &) = delete;
+		TripleBuffer & operator=(const TripleBuffer &) = delete;
+
+		// writer: the slot to fill, it keeps its contents from the last time it was written
+		T & getWriteBuffer() {
+			return m_slots[m_write];
+		}
+
+		// writer: hands the filled slot to the reader
+		void publish() {
+			m_write = m_middle.exchange(m_write | Fresh, std::memory_order_acq_rel) & Index;
+		}
+
+		// reader: takes the last slot published, false if nothing was published since the last call
+		bool update() {
+			if (!(m_middle.load(std::memory_order_relaxed) & Fresh)) return false;
+			m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & Index;
+			return true;
+		}
+
+		// reader: the slot taken by the last update()
+		const T & getReadBuffer() const {
+			return m_slots[m_read];
+		}
+
+	private:
+		static const unsigned int Index = 3;
+		static const unsigned int Fresh = 4; // set on the middle slot once published, cleared when the reader takes it
+
+		T m_slots[3];
+		std::atomic<unsigned int> m_middle;
+		unsigned int m_write;
+		unsigned int m_read;
+	};
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+namespace ami
+{
+	// vertex, face and constraint indices, same type as ofIndexType on desktop so wide index buffers go to ofMesh unchanged
+	typedef unsigned int IndexType;
+	// vertex ids of graphs and meshes of at most 65536 vertices, ids 0 to 65535, see PatternGraph
+	typedef std::uint16_t CompactIndexType;
+
+	// openFrameworks defines PI, TWO_PI and DEG_TO_RAD as macros, so these keep different names
+	const float Pi = 3.14159265358979323846f;
+	const float TwoPi = 2.0f * Pi;
+	const float DegToRad = Pi / 180.0f;
+}
@@ -0,0 +1,287 @@
+#include "XmlReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace ami
+{
+	namespace
+	{
+		inline bool isSpace(char c)
+		{
+			return std::isspace((unsigned char)c) != 0;
+		}
+	}
+
+	XmlReader::XmlReader(std::size_t chunkSize)
+		:
+		m_chunkSize(std::max<std::size_t>(chunkSize, 1)),
+		m_in(nullptr),
+		m_pos(0)
+	{}
+
+	bool XmlReader::parse(std::istream & in, Handler & handler)
+	{
+		m_in = &in;
+		m_buffer.clear();
+		m_pos = 0;
+		m_open.clear();
+		m_error.clear();
+
+		while (available(1))
+		{
+			if (m_buffer[m_pos] != '<')
+			{
+				if (!readText(handler)) return false;
+				continue;
+			}
+
+			if (startsWith("<!--"))
+			{
+				std::size_t end = find("-->");
+				if (end == std::string::npos) return fail("Unterminated comment");
+				m_pos += end + 3;
+			}
+			else if (startsWith("<![CDATA["))
+			{
+				std::size_t end = find("]]>");
+				if (end == std::string::npos) return fail("Unterminated CDATA");
+				handler.characters(m_buffer.data() + m_pos + 9, end - 9);
+				m_pos += end + 3;
+			}
+			else if (startsWith("<?"))
+			{
+				std::size_t end = find("?>");
+				if (end == std::string::npos) return fail("Unterminated declaration");
+				m_pos += end + 2;
+			}
+			else if (startsWith("<!"))
+			{
+				std::size_t end = find(">");
+				if (end == std::string::npos) return fail("Unterminated declaration");
+				m_pos += end + 1;
+			}
+			else
+			{
+				std::size_t end = findTagEnd();
+				if (end == std::string::npos) return fail("Unterminated tag");
+
+				bool bEnd = startsWith("</");
+				bool bOk = bEnd ? readEndTag(handler, end) : readStartTag(handler, end);
+				if (!bOk) return false;
+				m_pos += end + 1;
+			}
+		}
+
+		if (!m_open.empty()) return fail("Unclosed element " + m_open.back());
+		return true;
+	}
+
+	const std::string & XmlReader::getAttribute(const Attributes & attributes, const std::string & name, const std::string & fallback)
+	{
+		for (auto & attribute : attributes)
+		{
+			if (attribute.first == name) return attribute.second;
+		}
+		return fallback;
+	}
+
+	bool XmlReader::fill()
+	{
+		if (!m_in || !*m_in) return false;
+
+		m_buffer.erase(0, m_pos);
+		m_pos = 0;
+
+		std::size_t size = m_buffer.size();
+		m_buffer.resize(size + m_chunkSize);
+		m_in->read(&m_buffer[size], m_chunkSize);
+		std::size_t read = (std::size_t)m_in->gcount();
+		m_buffer.resize(size + read);
+
+		return read > 0;
+	}
+
+	bool XmlReader::available(std::size_t count)
+	{
+		while (m_buffer.size() - m_pos < count)
+		{
+			if (!fill()) return false;
+		}
+		return true;
+	}
+
+	bool XmlReader::startsWith(const char * token)
+	{
+		std::size_t length = std::strlen(token);
+		return available(length) && m_buffer.compare(m_pos, length, token) == 0;
+	}
+
+	std::size_t XmlReader::find(const char * token)
+	{
+		std::size_t length = std::strlen(token);
+		std::size_t searched = 0; // offsets already known not to start the token
+		while (true)
+		{
+			std::size_t found = m_buffer.find(token, m_pos + searched);
+			if (found != std::string::npos) return found - m_pos;
+
+			std::size_t size = m_buffer.size() - m_pos;
+			searched = size >= length ? size - length + 1 : 0;
+			if (!fill()) return std::string::npos;
+		}
+	}
+
+	std::size_t XmlReader::findTagEnd()
+	{
+		char quote = 0;
+		std::size_t offset = 1;
+		while (true)
+		{
+			for (; m_pos + offset < m_buffer.size(); offset++)
+			{
+				char c = m_buffer[m_pos + offset];
+				if (quote)
+				{
+					if (c == quote) quote = 0;
+				}
+				else if (c == '"' || c == '\'')
+				{
+					quote = c;
+				}
+				else if (c == '>')
+				{
+					return offset;
+				}
+			}
+			if (!fill()) return std::string::npos;
+		}
+	}
+
+	bool XmlReader::readText(Handler & handler)
+	{
+		std::size_t end = m_buffer.find('<', m_pos);
+		if (end == std::string::npos)
+		{
+			end = m_buffer.size();
+
+			// keep an entity split by the end of the chunk for the next piece
+			std::size_t amp = m_buffer.rfind('&');
+			if (amp != std::string::npos && amp >= m_pos && m_buffer.find(';', amp) == std::string::npos)
+			{
+				end = amp;
+				if (end == m_pos)
+				{
+					std::size_t size = m_buffer.size() - m_pos;
+					if (!available(size + 1)) end = m_buffer.size(); // input ends with a lone '&'
+					else return true;
+				}
+			}
+		}
+
+		m_text.clear();
+		decode(m_buffer.data() + m_pos, end - m_pos, m_text);
+		handler.characters(m_text.data(), m_text.size());
+		m_pos = end;
+		return true;
+	}
+
+	bool XmlReader::readStartTag(Handler & handler, std::size_t end)
+	{
+		const char * tag = m_buffer.data() + m_pos;
+
+		bool bEmpty = tag[end - 1] == '/';
+		std::size_t tagEnd = bEmpty ? end - 1 : end;
+
+		std::size_t i = 1;
+		while (i < tagEnd && !isSpace(tag[i])) i++;
+		m_name.assign(tag + 1, i - 1);
+		if (m_name.empty()) return fail("Element without name");
+
+		// name="value" or name='value'
+		m_attributes.clear();
+		while (true)
+		{
+			while (i < tagEnd && isSpace(tag[i])) i++;
+			if (i >= tagEnd) break;
+
+			std::size_t nameBegin = i;
+			while (i < tagEnd && tag[i] != '=' && !isSpace(tag[i])) i++;
+			std::size_t nameEnd = i;
+
+			while (i < tagEnd && (tag[i] == '=' || isSpace(tag[i]))) i++;
+			if (i >= tagEnd || (tag[i] != '"' && tag[i] != '\'')) return fail("Attribute without quoted value in " + m_name);
+
+			char quote = tag[i++];
+			std::size_t valueBegin = i;
+			while (i < tagEnd && tag[i] != quote) i++;
+			if (i >= tagEnd) return fail("Unterminated attribute value in " + m_name);
+
+			m_attributes.emplace_back(std::string(tag + nameBegin, nameEnd - nameBegin), std::string());
+			decode(tag + valueBegin, i - valueBegin, m_attributes.back().second);
+			i++;
+		}
+
+		handler.startElement(m_name, m_attributes);
+		if (bEmpty)
+		{
+			handler.endElement(m_name);
+		}
+		else
+		{
+			m_open.push_back(m_name);
+		}
+		return true;
+	}
+
+	bool XmlReader::readEndTag(Handler & handler, std::size_t end)
+	{
+		const char * tag = m_buffer.data() + m_pos;
+
+		std::size_t begin = 2;
+		while (begin < end && isSpace(tag[begin])) begin++;
+		while (end > begin && isSpace(tag[end - 1])) end--;
+		m_name.assign(tag + begin, end - begin);
+
+		if (m_open.empty() || m_open.back() != m_name) return fail("Unexpected end tag " + m_name);
+		m_open.pop_back();
+
+		handler.endElement(m_name);
+		return true;
+	}
+
+	void XmlReader::decode(const char * text, std::size_t length, std::string & out)
+	{
+		static const struct { const char * entity; char c; } entities[] = {
+			{ "&lt;", '<' }, { "&gt;", '>' }, { "&amp;", '&' }, { "&quot;", '"' }, { "&apos;", '\'' }
+		};
+
+		for (std::size_t i = 0; i < length; i++)
+		{
+			if (text[i] == '&')
+			{
+				bool bDecoded = false;
+				for (auto & entity : entities)
+				{
+					std::size_t entityLength = std::strlen(entity.entity);
+					if (i + entityLength <= length && std::strncmp(text + i, entity.entity, entityLength) == 0)
+					{
+						out.push_back(entity.c);
+						i += entityLength - 1;
+						bDecoded = true;
+						break;
+					}
+				}
+				if (bDecoded) continue;
+			}
+			out.push_back(text[i]);
+		}
+	}
+
+	bool XmlReader::fail(const std::string & error)
+	{
+		m_error = error;
+		return false;
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ami
+{
+	// Streaming SAX style xml reader: one pass over the input, read in fixed size chunks
+	// Memory is the chunk plus the longest tag, whatever the input size
+	// Handles elements, attributes, text, comments, declarations, CDATA and the predefined entities
+	class XmlReader
+	{
+	public:
+		typedef std::vector<std::pair<std::string, std::string>> Attributes;
+
+		class Handler
+		{
+		public:
+			virtual ~Handler() {}
+
+			virtual void startElement(const std::string & name, const Attributes & attributes) = 0;
+			virtual void endElement(const std::string & name) = 0;
+
+			// text may arrive in several pieces between two tags
+			virtual void characters(const char * text, std::size_t length) = 0;
+		};
+
+		XmlReader(std::size_t chunkSize = 64 * 1024);
+
+		// false on malformed input: unterminated markup or mismatched end tags, events up to the error were sent
+		bool parse(std::istream & in, Handler & handler);
+
+		// the error of the last failed parse
+		const std::string & getError() const {
+			return m_error;
+		}
+
+		// value of an attribute, or fallback if missing
+		static const std::string & getAttribute(const Attributes & attributes, const std::string & name, const std::string & fallback);
+
+	private:
+		// drops the consumed input and reads the next chunk, false at the end of the input
+		bool fill();
+		// makes count characters from m_pos available, false if the input ends first
+		bool available(std::size_t count);
+		bool startsWith(const char * token);
+		// offset of token from m_pos, std::string::npos if the input ends first
+		std::size_t find(const char * token);
+		// offset of the closing '>' of a tag from m_pos, skipping quoted attribute values
+		std::size_t findTagEnd();
+
+		bool readText(Handler & handler);
+		bool readStartTag(Handler & handler, std::size_t end);
+		bool readEndTag(Handler & handler, std::size_t end);
+
+		// appends text to out with the entities replaced
+		static void decode(const char * text, std::size_t length, std::string & out);
+
+		bool fail(const std::string & error);
+
+		std::size_t m_chunkSize;
+		std::istream * m_in;
+		std::string m_buffer;
+		std::size_t m_pos;
+
+		// open elements, to check end tags
+		std::vector<std::string> m_open;
+
+		// reused between tags
+		std::string m_name;
+		std::string m_text;
+		Attributes m_attributes;
+
+		std::string m_error;
+	};
+}
@@ -1,17 +1,16 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "HeadlessApp.h"
 #include "cxxopts.hpp"
 
 //========================================================================
 int main(int argc, char *argv[]) {
-	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
-
-	// this kicks off the running of my app
-	// can be OF_WINDOW or OF_FULLSCREEN
-	// pass in width and height too:
-
 	ofApp::Settings settings;
 	settings.step = false;
+	settings.threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	HeadlessApp::Settings headless;
+	bool bHeadless = false;
 
 	try
 	{
@@ -24,15 +23,35 @@ int main(int argc, char *argv[]) {
 			.allow_unrecognised_options()
 			.add_options()
 			("s,step", "Add points one by one and build amigurumi step by step", cxxopts::value<bool>(settings.step))
+			("t,threads", "Threads used by the constraint solver", cxxopts::value<unsigned int>(settings.threads))
 			;
 
-		auto result = options.parse(argc, argv);
+		options
+			.add_options("Headless")
+			("headless", "Relax a pattern without opening a window and write it as .obj", cxxopts::value<bool>(bHeadless))
+			;
+		HeadlessApp::addOptions(options, headless);
 
-		ofRunApp(new ofApp(settings));
+		auto result = options.parse(argc, argv);
+		headless.threads = settings.threads;
 	}
 	catch (const cxxopts::OptionException& e)
 	{
 		std::cout << "error parsing options: " << e.what() << std::endl;
 		exit(1);
 	}
+
+	if (bHeadless)
+	{
+		// no window and no GL context, only the pattern and the simulation
+		Log::setLevel(Log::LOG_NOTICE);
+		return HeadlessApp(headless).run();
+	}
+
+	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
+
+	// this kicks off the running of my app
+	// can be OF_WINDOW or OF_FULLSCREEN
+	// pass in width and height too:
+	ofRunApp(new ofApp(settings));
 }
@@ -10,6 +10,19 @@ ofApp::ofApp(const ofApp::Settings & settings)
 //--------------------------------------------------------------
 void ofApp::setup(){
 	ofSetLogLevel(OF_LOG_VERBOSE);
+
+	// core library messages go through ofLog, which filters them with its own level
+	Log::setLevel(Log::LOG_VERBOSE);
+	Log::setHandler([](Log::Level level, const std::string & module, const std::string & message)
+	{
+		switch (level)
+		{
+			case Log::LOG_VERBOSE: ofLogVerbose(module) << message; break;
+			case Log::LOG_NOTICE: ofLogNotice(module) << message; break;
+			case Log::LOG_WARNING: ofLogWarning(module) << message; break;
+			default: ofLogError(module) << message; break;
+		}
+	});
 	ofEnableDepthTest();
 	ofDisableArbTex();
 
@@ -23,26 +36,31 @@ void ofApp::setup(){
 
 	m_filepath = "whale.xml";
 
+	m_view.setThreadCount(m_settings.threads);
+	m_view.setCache(ofToDataPath("cache"));
+
 	try
 	{
-		m_patterns = PatternDigest::digest(m_filepath);
-		m_view.setPattern(m_patterns[0], m_settings.step);
+		PatternIndex patterns;
+		patterns.open(ofToDataPath(m_filepath));
+		m_view.setPattern(patterns.getPattern(0), m_settings.step);
 	}
-	catch (std::invalid_argument & e)
+	catch (std::logic_error & e)
 	{
 		ofLogError("ofApp") << "Pattern graph failed: " << e.what();
 		ofExit();
 	}
+	m_watcher.setFile(ofToDataPath(m_filepath));
+	m_bNewFile = false;
 
+	// the view simulates on its own thread at a fixed step, whatever the frame rate
 	m_bRun = true;
-	
-	m_fixedUpdateMillis = 0.016f; // simulate update every 16ms
-	m_leftOverTime = 0.0f;
+	m_view.setRunning(m_bRun);
 
 	m_helpInfo =
 		string("Left click to move camera \n") +
 		"Right click to zoom \n" +
-		"Space to reset \n" +
+		"Space to reload the pattern, saving its file reloads it too \n" +
 		"L to load new pattern \n" + 
 		"P to pause and resume \n" +
 		"S to run an update step \n"
@@ -51,31 +69,43 @@ void ofApp::setup(){
 
 //--------------------------------------------------------------
 void ofApp::update(){
-	if (m_bRun)
+	// saving the pattern file reloads it, the current pattern keeps running while it loads
+	if (m_watcher.hasChanged())
 	{
-		// fixed update time, lasting a total of a frame time
-		float elapsedTime = 2.0f / m_fps; // maximum allowed elapsed time is twice the fps, to avoid peaks
-		elapsedTime = std::fmin(elapsedTime, ofGetLastFrameTime() * 1.0f);
-
-		// add time that couldn't be used last frame
-		elapsedTime += m_leftOverTime;
-
-		// divide it up in chunks of fixed updates
-		unsigned int timesteps = std::floor(elapsedTime / m_fixedUpdateMillis);
-
-		// store time we couldn't use for the next frame.
-		m_leftOverTime = elapsedTime - timesteps * m_fixedUpdateMillis;
+		this->requestReload();
+	}
 
-		// update with a fixed timestep many times
-		for (unsigned int i = 0; i < timesteps; i++) {
-			updateStep(m_fixedUpdateMillis);
+	// a finished load is swapped in here, between two frames
+	std::unique_ptr<PatternLoader::Result> loaded = m_loader.poll();
+	if (loaded && loaded->file == ofToDataPath(m_filepath)) // a load of a file no longer shown is dropped
+	{
+		if (loaded->error.empty())
+		{
+			m_view.applyLoaded(*loaded, !m_bNewFile);
+			m_bNewFile = false;
+		}
+		else
+		{
+			ofLogError("ofApp") << "Load failed: " << loaded->error;
 		}
 	}
 }
 
-void ofApp::updateStep(float dt)
+void ofApp::requestReload()
 {
-	m_view.update(dt);
+	// the same file keeps the rounds it shares with the pattern shown, another one starts over
+	std::unique_ptr<PatternLoader::Previous> previous;
+	if (!m_bNewFile) previous = m_view.getPrevious();
+	m_loader.request(ofToDataPath(m_filepath), m_view.getCache(), m_view.getSolver(), std::move(previous));
+}
+
+void ofApp::requestLoad(const std::string & filepath)
+{
+	// the load of the previous file, if any, is cancelled by the request
+	m_filepath = filepath;
+	m_watcher.setFile(ofToDataPath(m_filepath));
+	m_bNewFile = true;
+	this->requestReload();
 }
 
 
@@ -88,40 +118,40 @@ void ofApp::draw(){
 		m_cam.end();
 
 	ofDrawBitmapStringHighlight(m_helpInfo, glm::vec3(50, 50, 0));
+
+	PatternLoader::Progress progress = m_loader.getProgress();
+	if (progress.stage != PatternLoader::IDLE)
+	{
+		static const char * stages[] = { "", "parsing", "building graph", "building mesh" };
+		std::stringstream ss;
+		ss << "Loading " << ofFilePath::getFileName(progress.file) << ": " << stages[progress.stage] << " " << int(progress.fraction * 100.f) << "%";
+		ofDrawBitmapStringHighlight(ss.str(), glm::vec3(50, ofGetHeight() - 50, 0));
+	}
 }
 
 //--------------------------------------------------------------
 void ofApp::keyPressed(int key) {
 	if (key == ' ')
 	{
-		m_patterns = PatternDigest::digest(m_filepath);
-		m_view.setPattern(m_patterns[0], m_settings.step);
+		this->requestReload();
 	}
 	if (key == 'l' || key == 'L')
 	{
 		auto res = ofSystemLoadDialog("Load pattern", false, "data");
 		if (res.bSuccess)
 		{
-			m_filepath = res.filePath;
-			try
-			{
-				m_patterns = PatternDigest::digest(m_filepath);
-				m_view.setPattern(m_patterns[0], m_settings.step);
-			}
-			catch (std::invalid_argument & e)
-			{
-				ofLogError("ofApp") << "Pattern graph failed: " << e.what();
-			}
+			this->requestLoad(res.filePath);
 		}
 	}
 	if (key == 'p' || key == 'P')
 	{
 		m_bRun = !m_bRun;
+		m_view.setRunning(m_bRun);
 	}
 
 	if (key == 's' || key == 'S')
 	{
-		this->updateStep(m_fixedUpdateMillis);
+		m_view.step();
 	}
 }
 
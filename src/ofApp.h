@@ -2,7 +2,9 @@
 
 #include "ofMain.h"
 
-#include "PatternDigest.h"
+#include "FileWatcher.h"
+#include "PatternIndex.h"
+#include "PatternLoader.h"
 #include "PatternView.h"
 
 using namespace ami;
@@ -13,6 +15,7 @@ public:
 	struct Settings
 	{
 		bool step;
+		unsigned int threads;
 	};
 
 	ofApp(const ofApp::Settings & settings);
@@ -30,17 +33,22 @@ public:
 	void dragEvent(ofDragInfo dragInfo);
 	void gotMessage(ofMessage msg);
 
-	void updateStep(float dt);
+	// loads m_filepath again in the background, update() swaps it in when it is ready
+	void requestReload();
+	// loads another file in the background, the current pattern keeps running until it is ready
+	void requestLoad(const std::string & filepath);
 
 	std::string m_helpInfo;
 
 	std::string m_filepath;
 	ofEasyCam m_cam;
 	PatternView m_view;
-	std::vector<PatternDef> m_patterns;
 
-	float m_leftOverTime;
-	float m_fixedUpdateMillis;
+	FileWatcher m_watcher;
+	PatternLoader m_loader;
+	// the load requested is of another file, it starts over instead of keeping the shared rounds
+	bool m_bNewFile;
+
 	float m_fps;
 	bool m_bRun;
 